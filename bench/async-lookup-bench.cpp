@@ -0,0 +1,89 @@
+// Lookups one after another against the same lookups interleaved on a `lookup_scheduler`,
+// with different numbers of them in flight.
+//
+// usage: async-lookup-bench [pairs] [lookups]
+
+#include "bimap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+using int_bimap = bimap<int, int>;
+
+template <typename F>
+double measure(std::size_t lookups, F f) {
+  auto begin = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+  return elapsed.count() / static_cast<double>(lookups);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+// GCC 12 warns about a null pointer constant in the frame code of every coroutine.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+lookup_scheduler::task find_all(const int_bimap& b, const std::vector<int>& keys, std::size_t first, std::size_t step,
+                                std::size_t& found) {
+  for (std::size_t i = first; i < keys.size(); i += step) {
+    found += co_await b.find_left_async(keys[i]) != b.end_left();
+  }
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic pop
+#endif
+
+} // namespace
+
+int main(int argc, char** argv) {
+  int pairs = argc > 1 ? std::atoi(argv[1]) : 1 << 22;
+  std::size_t lookups = argc > 2 ? static_cast<std::size_t>(std::atoll(argv[2])) : 1 << 21;
+
+  // Inserted in random order, so that neighbouring keys are far apart in memory.
+  std::mt19937 e(1);
+  std::vector<int> keys(static_cast<std::size_t>(pairs));
+  for (int i = 0; i < pairs; ++i) {
+    keys[static_cast<std::size_t>(i)] = 2 * i;
+  }
+  std::shuffle(keys.begin(), keys.end(), e);
+  int_bimap b;
+  for (int key : keys) {
+    b.insert(key, key);
+  }
+  std::uniform_int_distribution<int> key(0, 2 * pairs - 1);
+  std::vector<int> queries(lookups);
+  for (int& query : queries) {
+    query = key(e);
+  }
+
+  std::size_t expected = 0;
+  double plain = measure(lookups, [&] {
+    for (int query : queries) {
+      expected += b.find_left(query) != b.end_left();
+    }
+  });
+  std::printf("%d pairs, %zu lookups\n", pairs, lookups);
+  std::printf("%10s %12s\n", "in flight", "ns/lookup");
+  std::printf("%10s %12.1f\n", "plain", plain);
+  for (std::size_t in_flight = 1; in_flight <= 64; in_flight *= 2) {
+    std::size_t found = 0;
+    double interleaved = measure(lookups, [&] {
+      lookup_scheduler scheduler;
+      for (std::size_t i = 0; i < in_flight; ++i) {
+        scheduler.spawn(find_all(b, queries, i, in_flight, found));
+      }
+      scheduler.run();
+    });
+    if (found != expected) {
+      std::fprintf(stderr, "mismatch: %zu found, %zu expected\n", found, expected);
+      return EXIT_FAILURE;
+    }
+    std::printf("%10zu %12.1f\n", in_flight, interleaved);
+  }
+}
@@ -0,0 +1,133 @@
+// Throughput of `sharded_bimap` against a bimap behind one reader-writer lock, from 1 to 64 threads.
+//
+// usage: sharded-bimap-bench [pairs] [operations per thread] [percent of lookups]
+
+#include "sharded-bimap.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class locked_bimap {
+public:
+  bool insert(int left, int right) {
+    std::unique_lock lock(mutex);
+    return pairs.insert(left, right) != pairs.end_left();
+  }
+
+  bool erase_left(int left) {
+    std::unique_lock lock(mutex);
+    return pairs.erase_left(left);
+  }
+
+  bool erase_right(int right) {
+    std::unique_lock lock(mutex);
+    return pairs.erase_right(right);
+  }
+
+  bool find_left(int left) const {
+    std::shared_lock lock(mutex);
+    return pairs.find_left(left) != pairs.end_left();
+  }
+
+  bool find_right(int right) const {
+    std::shared_lock lock(mutex);
+    return pairs.find_right(right) != pairs.end_right();
+  }
+
+private:
+  mutable std::shared_mutex mutex;
+  bimap<int, int> pairs;
+};
+
+struct config {
+  int pairs = 1 << 20;
+  int operations = 1 << 18;
+  unsigned lookups = 90;
+};
+
+// Keys are drawn from twice the prefilled range, so about half of the lookups miss
+// and inserts and erases keep the size roughly where it started.
+template <typename Map>
+double run(Map& map, const config& c, unsigned threads) {
+  std::vector<std::thread> workers;
+  std::atomic<unsigned> ready = 0;
+  std::atomic<bool> start = false;
+  std::atomic<std::size_t> sink = 0;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::mt19937 e(t + 1);
+      std::uniform_int_distribution<int> key(0, 2 * c.pairs - 1);
+      std::size_t found = 0;
+      ++ready;
+      while (!start) {
+        std::this_thread::yield();
+      }
+      for (int i = 0; i < c.operations; ++i) {
+        unsigned op = e() % 100;
+        int k = key(e);
+        if (op < c.lookups) {
+          found += op % 2 == 0 ? static_cast<bool>(map.find_left(k)) : static_cast<bool>(map.find_right(k));
+        } else if (op % 2 == 0) {
+          found += map.insert(k, k);
+        } else {
+          found += map.erase_left(k);
+        }
+      }
+      sink += found;
+    });
+  }
+  while (ready != threads) {
+    std::this_thread::yield();
+  }
+  auto begin = std::chrono::steady_clock::now();
+  start = true;
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+  return static_cast<double>(threads) * c.operations / elapsed.count() / 1e6;
+}
+
+template <typename Map>
+void prefill(Map& map, const config& c) {
+  for (int i = 0; i < c.pairs; ++i) {
+    map.insert(2 * i, 2 * i);
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  config c;
+  if (argc > 1) {
+    c.pairs = std::atoi(argv[1]);
+  }
+  if (argc > 2) {
+    c.operations = std::atoi(argv[2]);
+  }
+  if (argc > 3) {
+    c.lookups = static_cast<unsigned>(std::atoi(argv[3]));
+  }
+
+  std::printf("%d pairs, %d operations per thread, %u%% lookups, %u hardware threads\n", c.pairs, c.operations,
+              c.lookups, std::thread::hardware_concurrency());
+  std::printf("%8s %16s %16s\n", "threads", "one lock, Mop/s", "sharded, Mop/s");
+  for (unsigned threads = 1; threads <= 64; threads *= 2) {
+    locked_bimap locked;
+    prefill(locked, c);
+    sharded_bimap<int, int> sharded(256);
+    prefill(sharded, c);
+    double locked_rate = run(locked, c, threads);
+    double sharded_rate = run(sharded, c, threads);
+    std::printf("%8u %16.2f %16.2f\n", threads, locked_rate, sharded_rate);
+  }
+}
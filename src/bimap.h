@@ -1,84 +1,3887 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <concepts>
+#include <coroutine>
 #include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <execution>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-template <typename Left, typename Right, typename CompareLeft, typename CompareRight>
+namespace bimap_details {
+
+struct left_tag {};
+
+struct right_tag {};
+
+template <typename Tag>
+using opposite_tag = std::conditional_t<std::is_same_v<Tag, left_tag>, right_tag, left_tag>;
+
+// Links of one node in one of the two trees. `children[0]` is the left child, `children[1]` is the right one,
+// so that symmetric algorithms can be written once and parameterized by direction.
+struct tree_node {
+  tree_node* parent = nullptr;
+  tree_node* children[2] = {nullptr, nullptr};
+};
+
+// Tree links that also thread the nodes in order: `threads[1]` is the successor, `threads[0]` the predecessor.
+// Together with the sentinel, which starts out linked to itself, the threads form a circular list.
+struct threaded_tree_node {
+  threaded_tree_node* parent = nullptr;
+  threaded_tree_node* children[2] = {nullptr, nullptr};
+  threaded_tree_node* threads[2] = {this, this};
+};
+
+template <typename Node>
+inline constexpr bool is_threaded_v = requires(Node& node) { node.threads; };
+
+// Pointer stored as a 32-bit offset from its own address, in units of the alignment of `Node`.
+// Copies store the offset to the same target, so a link stays valid wherever it is copied to
+// as long as the target is within reach. `relocate_from` copies the raw offset instead,
+// for moving a whole block of nodes at once.
+template <typename Node>
+class relative_link {
+public:
+  relative_link() noexcept = default;
+
+  relative_link(const relative_link& other) noexcept {
+    *this = other.get();
+  }
+
+  relative_link& operator=(const relative_link& other) noexcept {
+    return *this = other.get();
+  }
+
+  relative_link& operator=(Node* target) noexcept {
+    if (target) {
+      offset = static_cast<std::int32_t>((reinterpret_cast<std::byte*>(target) - address()) / unit);
+    } else {
+      offset = null;
+    }
+    return *this;
+  }
+
+  operator Node*() const noexcept {
+    return get();
+  }
+
+  Node* operator->() const noexcept {
+    return get();
+  }
+
+  Node* get() const noexcept {
+    if (offset == null) {
+      return nullptr;
+    }
+    return reinterpret_cast<Node*>(address() + static_cast<std::ptrdiff_t>(offset) * unit);
+  }
+
+  void relocate_from(const relative_link& other) noexcept {
+    offset = other.offset;
+  }
+
+  // Largest distance in bytes that a link can span.
+  static constexpr std::uint64_t reach = (std::uint64_t(1) << 31) * alignof(Node);
+
+private:
+  static constexpr std::ptrdiff_t unit = alignof(Node);
+  static constexpr std::int32_t null = std::numeric_limits<std::int32_t>::min();
+
+  std::byte* address() const noexcept {
+    return const_cast<std::byte*>(reinterpret_cast<const std::byte*>(this));
+  }
+
+  std::int32_t offset = null;
+};
+
+// Tree links that take 12 bytes instead of 24. They only work between nodes of one `node_pool`.
+struct compact_tree_node {
+  relative_link<compact_tree_node> parent;
+  relative_link<compact_tree_node> children[2];
+
+  void relocate_from(const compact_tree_node& other) noexcept {
+    parent.relocate_from(other.parent);
+    children[0].relocate_from(other.children[0]);
+    children[1].relocate_from(other.children[1]);
+  }
+};
+
+template <typename Node>
+Node* extreme(Node* node, int dir) noexcept {
+  while (node->children[dir]) {
+    node = node->children[dir];
+  }
+  return node;
+}
+
+// In-order step: successor for `dir == 1`, predecessor for `dir == 0`.
+// The sentinel keeps the root as its left child, so it acts as the element after the maximum.
+template <typename Node>
+Node* step(Node* node, int dir) noexcept {
+  if constexpr (is_threaded_v<Node>) {
+    return node->threads[dir];
+  } else {
+    if (node->children[dir]) {
+      return extreme<Node>(node->children[dir], !dir);
+    }
+    while (node->parent->children[dir] == node) {
+      node = node->parent;
+    }
+    return node->parent;
+  }
+}
+
+// Puts `node` into the in-order list right before (`dir == 0`) or after (`dir == 1`) `neighbour`.
+template <typename Node>
+void thread(Node* node, Node* neighbour, int dir) noexcept {
+  if constexpr (is_threaded_v<Node>) {
+    Node* far = neighbour->threads[dir];
+    node->threads[dir] = far;
+    node->threads[!dir] = neighbour;
+    far->threads[!dir] = node;
+    neighbour->threads[dir] = node;
+  }
+}
+
+template <typename Node>
+void unthread(Node* node) noexcept {
+  if constexpr (is_threaded_v<Node>) {
+    node->threads[0]->threads[1] = node->threads[1];
+    node->threads[1]->threads[0] = node->threads[0];
+  }
+}
+
+template <typename Node>
+void replace_child(Node* node, Node* replacement) noexcept {
+  Node* parent = node->parent;
+  parent->children[parent->children[1] == node] = replacement;
+  if (replacement) {
+    replacement->parent = parent;
+  }
+}
+
+template <typename Node>
+void link(Node* node, Node* parent, int dir) noexcept {
+  node->parent = parent;
+  node->children[0] = node->children[1] = nullptr;
+  parent->children[dir] = node;
+  thread(node, parent, dir);
+}
+
+// Links `node` right before `next`, which may be the sentinel, without comparing keys: as the left child
+// of `next`, or as the right child of the last node of its left subtree.
+template <typename Node>
+void link_before(Node* node, Node* next) noexcept {
+  if (Node* left = next->children[0]) {
+    link(node, extreme(left, 1), 1);
+  } else {
+    link(node, next, 0);
+  }
+}
+
+template <typename Node>
+void unlink(Node* node) noexcept {
+  unthread(node);
+  Node* left = node->children[0];
+  Node* right = node->children[1];
+  if (!left || !right) {
+    replace_child(node, left ? left : right);
+    return;
+  }
+  Node* successor = extreme(right, 0);
+  if (successor != right) {
+    replace_child<Node>(successor, successor->children[1]);
+    successor->children[1] = right;
+    right->parent = successor;
+  }
+  successor->children[0] = left;
+  left->parent = successor;
+  replace_child(node, successor);
+}
+
+// Puts `replacement` at the exact place of `node`, which leaves the tree.
+template <typename Node>
+void transplant(Node* node, Node* replacement) noexcept {
+  replace_child(node, replacement);
+  for (int dir = 0; dir < 2; ++dir) {
+    replacement->children[dir] = node->children[dir];
+    if (replacement->children[dir]) {
+      replacement->children[dir]->parent = replacement;
+    }
+  }
+  if constexpr (is_threaded_v<Node>) {
+    for (int dir = 0; dir < 2; ++dir) {
+      replacement->threads[dir] = node->threads[dir];
+      replacement->threads[dir]->threads[!dir] = replacement;
+    }
+  }
+}
+
+// Puts `node` in place of its parent, which becomes its child. The in-order sequence stays the same.
+template <typename Node>
+void rotate_up(Node* node) noexcept {
+  Node* parent = node->parent;
+  int dir = parent->children[1] == node;
+  Node* inner = node->children[!dir];
+  replace_child(parent, node);
+  parent->children[dir] = inner;
+  if (inner) {
+    inner->parent = parent;
+  }
+  node->children[!dir] = parent;
+  parent->parent = node;
+}
+
+// Moves `node` to the root of the tree of the sentinel `end` with splay steps: a node that goes the same way
+// as its parent rotates the parent first, which roughly halves the depth of every node on the path.
+template <typename Node>
+void splay(Node* node, Node* end) noexcept {
+  while (node->parent != end) {
+    Node* parent = node->parent;
+    if (parent->parent != end) {
+      bool same_way = (parent->children[1] == node) == (parent->parent->children[1] == parent);
+      rotate_up(same_way ? parent : node);
+    }
+    rotate_up(node);
+  }
+}
+
+// Result of a descent: either the node with an equivalent key, or the empty slot where such a key belongs.
+// `depth` is the number of nodes passed on the way, which is the depth a node linked into the slot gets.
+template <typename Node>
+struct position {
+  Node* parent;
+  int dir;
+  Node* found;
+  std::size_t depth;
+};
+
+// Links `node` into the slot described by `pos`, which may have been computed before some other node was unlinked.
+// If the unlink has filled the slot, the key still belongs right next to `pos.parent`,
+// so the new slot is found by a short walk down instead of a descent from the root.
+template <typename Node>
+void relink(Node* node, position<Node> pos) noexcept {
+  if (pos.parent->children[pos.dir]) {
+    pos.parent = extreme<Node>(pos.parent->children[pos.dir], !pos.dir);
+    pos.dir = !pos.dir;
+  }
+  link(node, pos.parent, pos.dir);
+}
+
+// Empties the tree of the sentinel `end` without touching its nodes.
+template <typename Node>
+void reset(Node* end) noexcept {
+  end->children[0] = nullptr;
+  if constexpr (is_threaded_v<Node>) {
+    end->threads[0] = end->threads[1] = end;
+  }
+}
+
+// Exchanges the trees of the sentinels `lhs` and `rhs`.
+template <typename Node>
+void swap_trees(Node* lhs, Node* rhs) noexcept {
+  Node* root = lhs->children[0];
+  lhs->children[0] = rhs->children[0];
+  rhs->children[0] = root;
+  if constexpr (is_threaded_v<Node>) {
+    for (int dir = 0; dir < 2; ++dir) {
+      Node* extreme_node = lhs->threads[dir];
+      lhs->threads[dir] = rhs->threads[dir];
+      rhs->threads[dir] = extreme_node;
+    }
+  }
+  for (Node* end : {lhs, rhs}) {
+    if (Node* new_root = end->children[0]) {
+      new_root->parent = end;
+      if constexpr (is_threaded_v<Node>) {
+        end->threads[0]->threads[1] = end;
+        end->threads[1]->threads[0] = end;
+      }
+    } else {
+      reset(end);
+    }
+  }
+}
+
+// First node of the tree of the sentinel `end`, or `end` itself if the tree is empty.
+template <typename Node>
+Node* first(Node* end) noexcept {
+  if constexpr (is_threaded_v<Node>) {
+    return end->threads[1];
+  } else {
+    return extreme(end, 0);
+  }
+}
+
+// Drops the nodes from `first` up to, but not including, `last` from the in-order list.
+template <typename Node>
+void unthread_range(Node* first, Node* last) noexcept {
+  if constexpr (is_threaded_v<Node>) {
+    Node* before = first->threads[0];
+    before->threads[1] = last;
+    last->threads[0] = before;
+  }
+}
+
+// Makes a sorted null-terminated list linked through `children[0]` the whole in-order list of the sentinel `end`.
+template <typename Node>
+void thread_list(Node* end, Node* head) noexcept {
+  if constexpr (is_threaded_v<Node>) {
+    Node* prev = end;
+    for (Node* cur = head; cur; cur = cur->children[0]) {
+      cur->threads[0] = prev;
+      prev->threads[1] = cur;
+      prev = cur;
+    }
+    prev->threads[1] = end;
+    end->threads[0] = prev;
+  }
+}
+
+// The functions below work on detached trees, whose roots have a null parent, and leave threads alone.
+
+// Splits the tree containing `node` into the nodes before it and `node` with everything after it.
+// Goes bottom-up along the path to the root, so no comparisons are needed and neither part gets taller.
+template <typename Node>
+std::pair<Node*, Node*> split_before(Node* node) noexcept {
+  Node* before = node->children[0];
+  Node* after = node;
+  node->children[0] = nullptr;
+  for (Node *cur = node, *parent = node->parent, *next; parent; cur = parent, parent = next) {
+    next = parent->parent;
+    if (parent->children[0] == cur) {
+      parent->children[0] = after;
+      after->parent = parent;
+      after = parent;
+    } else {
+      parent->children[1] = before;
+      if (before) {
+        before->parent = parent;
+      }
+      before = parent;
+    }
+  }
+  if (before) {
+    before->parent = nullptr;
+  }
+  after->parent = nullptr;
+  return {before, after};
+}
+
+// Joins two trees where every node of `left` goes before every node of `right`.
+// The minimum of `right` becomes the new root, so the height grows by at most one.
+template <typename Node>
+Node* join(Node* left, Node* right) noexcept {
+  if (!left || !right) {
+    return left ? left : right;
+  }
+  Node* root = extreme(right, 0);
+  if (root != right) {
+    root->parent->children[0] = root->children[1];
+    if (root->children[1]) {
+      root->children[1]->parent = root->parent;
+    }
+    root->children[1] = right;
+    right->parent = root;
+  }
+  root->children[0] = left;
+  left->parent = root;
+  root->parent = nullptr;
+  return root;
+}
+
+// Builds a perfectly balanced tree out of the first `count` nodes of a sorted list linked through `children[0]`.
+// `head` is advanced past the consumed nodes. Recursion depth is logarithmic.
+template <typename Node>
+Node* build_balanced(Node*& head, std::size_t count) noexcept {
+  if (count == 0) {
+    return nullptr;
+  }
+  Node* left = build_balanced(head, count / 2);
+  Node* root = head;
+  head = head->children[0];
+  root->children[0] = left;
+  root->children[1] = build_balanced(head, count - count / 2 - 1);
+  for (Node* child : root->children) {
+    if (child) {
+      child->parent = root;
+    }
+  }
+  return root;
+}
+
+template <typename Tag, typename TreeNode>
+struct tagged_node : TreeNode {};
+
+template <typename TreeNode>
+struct node_base
+    : tagged_node<left_tag, TreeNode>
+    , tagged_node<right_tag, TreeNode> {
+  template <typename Tag>
+  TreeNode* as() noexcept {
+    return static_cast<tagged_node<Tag, TreeNode>*>(this);
+  }
+
+  template <typename Tag>
+  static node_base* from(TreeNode* node) noexcept {
+    return static_cast<node_base*>(static_cast<tagged_node<Tag, TreeNode>*>(node));
+  }
+
+  template <typename Tag>
+  static const node_base* from(const TreeNode* node) noexcept {
+    return static_cast<const node_base*>(static_cast<const tagged_node<Tag, TreeNode>*>(node));
+  }
+};
+
+struct no_projection {};
+
+// Versions at which a pair was inserted and erased, and its neighbours in the list of live or erased pairs
+// of a bimap with a change log, from the oldest change to the newest.
+struct change_stamp {
+  std::uint64_t inserted;
+  std::uint64_t erased;
+  change_stamp* older;
+  change_stamp* newer;
+};
+
+struct no_change_stamp {};
+
+template <typename Projection, typename Tag>
+struct projection_slot {
+  Projection value;
+};
+
+// Takes no storage at all: two empty members of the same type could not share an address.
+template <typename Tag>
+struct projection_slot<no_projection, Tag> {
+  projection_slot(no_projection) noexcept {}
+
+  static constexpr no_projection value{};
+};
+
+// Tells a node constructor to move its left key out of another node and to give it back if the right key
+// throws, so that the other node stays intact. Moving the left key must not throw.
+struct reclaim_left_t {};
+
+inline constexpr reclaim_left_t reclaim_left{};
+
+// The key of a node under construction, built from `args`. If that throws, `taken`, the key already moved
+// out of `from`, is moved back first.
+template <typename Key, typename Taken, typename... Args>
+Key build_or_give_back(Taken& taken, Taken& from, Args&&... args) {
+  try {
+    return Key(std::forward<Args>(args)...);
+  } catch (...) {
+    std::destroy_at(std::addressof(from));
+    std::construct_at(std::addressof(from), std::move(taken));
+    throw;
+  }
+}
+
+template <
+    typename Left,
+    typename Right,
+    typename LeftProjection = no_projection,
+    typename RightProjection = no_projection,
+    typename TreeNode = tree_node,
+    typename Stamp = no_change_stamp>
+struct node
+    : node_base<TreeNode>
+    , Stamp {
+  template <typename L, typename R>
+  node(
+      L&& left,
+      R&& right,
+      const LeftProjection& left_projection = {},
+      const RightProjection& right_projection = {}
+  )
+      : left(std::forward<L>(left))
+      , right(std::forward<R>(right))
+      , left_projection{left_projection}
+      , right_projection{right_projection} {}
+
+  // Builds each key from a tuple of constructor arguments. The projections are to be filled in afterwards.
+  template <typename LeftArgs, typename RightArgs>
+  node(std::piecewise_construct_t, LeftArgs&& left_args, RightArgs&& right_args)
+      : left(std::make_from_tuple<Left>(std::forward<LeftArgs>(left_args)))
+      , right(std::make_from_tuple<Right>(std::forward<RightArgs>(right_args)))
+      , left_projection{LeftProjection{}}
+      , right_projection{RightProjection{}} {}
+
+  template <typename R>
+  node(
+      reclaim_left_t,
+      Left& from,
+      R&& right,
+      const LeftProjection& left_projection,
+      const RightProjection& right_projection
+  )
+      : left(std::move(from))
+      , right(build_or_give_back<Right>(left, from, std::forward<R>(right)))
+      , left_projection{left_projection}
+      , right_projection{right_projection} {}
+
+  template <typename Tag>
+  auto& key() noexcept {
+    if constexpr (std::is_same_v<Tag, left_tag>) {
+      return left;
+    } else {
+      return right;
+    }
+  }
+
+  template <typename Tag>
+  const auto& key() const noexcept {
+    return const_cast<node*>(this)->key<Tag>();
+  }
+
+  template <typename Tag>
+  auto& projection() noexcept {
+    if constexpr (std::is_same_v<Tag, left_tag>) {
+      return left_projection.value;
+    } else {
+      return right_projection.value;
+    }
+  }
+
+  template <typename Tag>
+  const auto& projection() const noexcept {
+    return const_cast<node*>(this)->projection<Tag>();
+  }
+
+  template <typename Tag>
+  static node* from(TreeNode* links) noexcept {
+    return static_cast<node*>(node_base<TreeNode>::template from<Tag>(links));
+  }
+
+  template <typename Tag>
+  static const node* from(const TreeNode* links) noexcept {
+    return static_cast<const node*>(node_base<TreeNode>::template from<Tag>(links));
+  }
+
+  Left left;
+  Right right;
+  [[no_unique_address]] projection_slot<LeftProjection, left_tag> left_projection;
+  [[no_unique_address]] projection_slot<RightProjection, right_tag> right_projection;
+};
+
+// Not `std::hardware_destructive_interference_size`, which is not stable across compiler flags.
+inline constexpr std::size_t cache_line_size = 64;
+
+// Links of one tree next to the key they order, starting a cache line of their own.
+template <typename Tag, typename Key, typename Projection, typename TreeNode>
+struct alignas(cache_line_size) node_half : tagged_node<Tag, TreeNode> {
+  template <typename K>
+  node_half(K&& key, const Projection& projection)
+      : key(std::forward<K>(key))
+      , projection{projection} {}
+
+  template <typename Args>
+  node_half(std::piecewise_construct_t, Args&& args)
+      : key(std::make_from_tuple<Key>(std::forward<Args>(args)))
+      , projection{Projection{}} {}
+
+  // The key is what `make` returns, built in place.
+  template <typename Make>
+  node_half(std::in_place_t, Make&& make, const Projection& projection)
+      : key(std::forward<Make>(make)())
+      , projection{projection} {}
+
+  Key key;
+  [[no_unique_address]] projection_slot<Projection, Tag> projection;
+};
+
+// Node with the same interface as `node`, split into a left half and a right half, so that a descent
+// in one tree does not bring the keys and links of the other one into the cache.
+template <
+    typename Left,
+    typename Right,
+    typename LeftProjection = no_projection,
+    typename RightProjection = no_projection,
+    typename TreeNode = tree_node,
+    typename Stamp = no_change_stamp>
+struct split_node
+    : node_half<left_tag, Left, LeftProjection, TreeNode>
+    , node_half<right_tag, Right, RightProjection, TreeNode>
+    , Stamp {
+  template <typename Tag>
+  using half = std::conditional_t<
+      std::is_same_v<Tag, left_tag>,
+      node_half<left_tag, Left, LeftProjection, TreeNode>,
+      node_half<right_tag, Right, RightProjection, TreeNode>>;
+
+  template <typename L, typename R>
+  split_node(
+      L&& left,
+      R&& right,
+      const LeftProjection& left_projection = {},
+      const RightProjection& right_projection = {}
+  )
+      : half<left_tag>(std::forward<L>(left), left_projection)
+      , half<right_tag>(std::forward<R>(right), right_projection) {}
+
+  template <typename LeftArgs, typename RightArgs>
+  split_node(std::piecewise_construct_t, LeftArgs&& left_args, RightArgs&& right_args)
+      : half<left_tag>(std::piecewise_construct, std::forward<LeftArgs>(left_args))
+      , half<right_tag>(std::piecewise_construct, std::forward<RightArgs>(right_args)) {}
+
+  template <typename R>
+  split_node(
+      reclaim_left_t,
+      Left& from,
+      R&& right,
+      const LeftProjection& left_projection,
+      const RightProjection& right_projection
+  )
+      : half<left_tag>(std::move(from), left_projection)
+      , half<right_tag>(
+            std::in_place,
+            [&] { return build_or_give_back<Right>(half<left_tag>::key, from, std::forward<R>(right)); },
+            right_projection
+        ) {}
+
+  template <typename Tag>
+  TreeNode* as() noexcept {
+    return static_cast<tagged_node<Tag, TreeNode>*>(this);
+  }
+
+  template <typename Tag>
+  auto& key() noexcept {
+    return half<Tag>::key;
+  }
+
+  template <typename Tag>
+  const auto& key() const noexcept {
+    return half<Tag>::key;
+  }
+
+  template <typename Tag>
+  auto& projection() noexcept {
+    return half<Tag>::projection.value;
+  }
+
+  template <typename Tag>
+  const auto& projection() const noexcept {
+    return half<Tag>::projection.value;
+  }
+
+  template <typename Tag>
+  static split_node* from(TreeNode* links) noexcept {
+    return static_cast<split_node*>(static_cast<half<Tag>*>(static_cast<tagged_node<Tag, TreeNode>*>(links)));
+  }
+
+  template <typename Tag>
+  static const split_node* from(const TreeNode* links) noexcept {
+    return from<Tag>(const_cast<TreeNode*>(links));
+  }
+};
+
+// Nodes chained through their change stamps, from the oldest change to the newest.
+template <typename Node>
+class change_list {
+public:
+  Node* oldest() const noexcept {
+    return static_cast<Node*>(head);
+  }
+
+  Node* newest() const noexcept {
+    return static_cast<Node*>(tail);
+  }
+
+  static Node* older(const Node* node) noexcept {
+    return static_cast<Node*>(node->older);
+  }
+
+  static Node* newer(const Node* node) noexcept {
+    return static_cast<Node*>(node->newer);
+  }
+
+  std::size_t size() const noexcept {
+    return count;
+  }
+
+  void push(Node* node) noexcept {
+    node->older = tail;
+    node->newer = nullptr;
+    (tail ? tail->newer : head) = node;
+    tail = node;
+    ++count;
+  }
+
+  void remove(Node* node) noexcept {
+    (node->older ? node->older->newer : head) = node->newer;
+    (node->newer ? node->newer->older : tail) = node->older;
+    --count;
+  }
+
+  friend void swap(change_list& lhs, change_list& rhs) noexcept {
+    std::swap(lhs.head, rhs.head);
+    std::swap(lhs.tail, rhs.tail);
+    std::swap(lhs.count, rhs.count);
+  }
+
+private:
+  change_stamp* head = nullptr;
+  change_stamp* tail = nullptr;
+  std::size_t count = 0;
+};
+
+// What a bimap with a change log remembers of its past: every change bumps `version`, live nodes are listed
+// in the order of insertion and erased ones in the order of erasure. Changes up to `horizon` are forgotten.
+template <typename Node>
+struct change_history {
+  change_list<Node> live;
+  change_list<Node> erased;
+  std::uint64_t version = 0;
+  std::uint64_t horizon = 0;
+
+  friend void swap(change_history& lhs, change_history& rhs) noexcept {
+    swap(lhs.live, rhs.live);
+    swap(lhs.erased, rhs.erased);
+    std::swap(lhs.version, rhs.version);
+    std::swap(lhs.horizon, rhs.horizon);
+  }
+};
+
+struct no_change_history {
+  friend void swap(no_change_history&, no_change_history&) noexcept {}
+};
+
+// Contiguous storage for nodes with compact links. The sentinel takes the first slot, so that every link
+// of a bimap stays within one block. Free slots are chained by index, the rest are handed out in order.
+template <typename Node, typename Sentinel>
+class node_pool {
+public:
+  // The largest capacity at which every link within the block still fits into 32 bits.
+  static constexpr std::size_t max_capacity = static_cast<std::size_t>(std::min<std::uint64_t>({
+      relative_link<compact_tree_node>::reach / sizeof(Node) - 1,
+      std::numeric_limits<std::uint32_t>::max() - 1,
+      std::numeric_limits<std::size_t>::max() / sizeof(Node) - 1,
+  }));
+
+  node_pool() noexcept = default;
+
+  explicit node_pool(std::size_t capacity)
+      : block(std::allocator<Node>().allocate(capacity + 1))
+      , head(::new (static_cast<void*>(block)) Sentinel())
+      , slots(capacity) {}
+
+  node_pool(const node_pool&) = delete;
+  node_pool& operator=(const node_pool&) = delete;
+
+  ~node_pool() {
+    if (block) {
+      std::destroy_at(head);
+      std::allocator<Node>().deallocate(block, slots + 1);
+    }
+  }
+
+  friend void swap(node_pool& lhs, node_pool& rhs) noexcept {
+    std::swap(lhs.block, rhs.block);
+    std::swap(lhs.head, rhs.head);
+    std::swap(lhs.slots, rhs.slots);
+    std::swap(lhs.used, rhs.used);
+    std::swap(lhs.free_head, rhs.free_head);
+  }
+
+  Sentinel* sentinel() const noexcept {
+    return head;
+  }
+
+  std::size_t capacity() const noexcept {
+    return slots;
+  }
+
+  Node* slot(std::size_t index) const noexcept {
+    return block + 1 + index;
+  }
+
+  std::size_t index_of(const Node* node) const noexcept {
+    return static_cast<std::size_t>(node - slot(0));
+  }
+
+  // Storage for one node. The caller makes sure that there is a free slot.
+  Node* allocate() noexcept {
+    if (free_head == none) {
+      return slot(used++);
+    }
+    Node* node = slot(free_head);
+    free_head = next_free(node);
+    return node;
+  }
+
+  void deallocate(Node* node) noexcept {
+    ::new (static_cast<void*>(node)) std::uint32_t(free_head);
+    free_head = static_cast<std::uint32_t>(index_of(node));
+  }
+
+  // Frees every slot at once. The nodes in them must have been destroyed, if they need to be.
+  void reset() noexcept {
+    used = 0;
+    free_head = none;
+  }
+
+  // Marks the first `n` slots as taken, with no free slots among them.
+  void take_slots(std::size_t n) noexcept {
+    used = n;
+    free_head = none;
+  }
+
+  // Takes over the free slots of `other`, whose nodes have been moved to the same indices in this pool.
+  void adopt_free_slots(const node_pool& other) noexcept {
+    used = other.used;
+    free_head = other.free_head;
+    for (std::uint32_t index = free_head; index != none; index = next_free(other.slot(index))) {
+      ::new (static_cast<void*>(slot(index))) std::uint32_t(next_free(other.slot(index)));
+    }
+  }
+
+private:
+  static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+  static std::uint32_t next_free(const Node* node) noexcept {
+    return *std::launder(reinterpret_cast<const std::uint32_t*>(node));
+  }
+
+  Node* block = nullptr;
+  Sentinel* head = nullptr;
+  std::size_t slots = 0;
+  std::size_t used = 0;
+  std::uint32_t free_head = none;
+};
+
+// Heap storage for nodes, allocated one at a time. Storage set aside by `reserve` or `recycle` is handed out
+// first and is chained through a pointer placed at its start.
+template <typename Node>
+class node_reserve {
+public:
+  node_reserve() noexcept = default;
+  node_reserve(const node_reserve&) = delete;
+  node_reserve& operator=(const node_reserve&) = delete;
+
+  ~node_reserve() {
+    release(0);
+  }
+
+  friend void swap(node_reserve& lhs, node_reserve& rhs) noexcept {
+    std::swap(lhs.head, rhs.head);
+    std::swap(lhs.spare, rhs.spare);
+  }
+
+  // The number of nodes that can be allocated without calling the allocator.
+  std::size_t size() const noexcept {
+    return spare;
+  }
+
+  Node* allocate() {
+    if (!head) {
+      return std::allocator<Node>().allocate(1);
+    }
+    free_node* node = head;
+    head = node->next;
+    --spare;
+    return static_cast<Node*>(static_cast<void*>(node));
+  }
+
+  void deallocate(Node* node) noexcept {
+    std::allocator<Node>().deallocate(node, 1);
+  }
+
+  // Keeps the storage of a destroyed node for a later `allocate`.
+  void recycle(Node* node) noexcept {
+    head = ::new (static_cast<void*>(node)) free_node{head};
+    ++spare;
+  }
+
+  void reserve(std::size_t n) {
+    while (spare < n) {
+      recycle(std::allocator<Node>().allocate(1));
+    }
+  }
+
+  // Gives back all set-aside storage but the first `n` nodes.
+  void release(std::size_t n) noexcept {
+    while (spare > n) {
+      deallocate(allocate());
+    }
+  }
+
+private:
+  struct free_node {
+    free_node* next;
+  };
+
+  free_node* head = nullptr;
+  std::size_t spare = 0;
+};
+
+// Storage for the first `Capacity` nodes of a bimap inside the bimap itself. Bit `i` of `occupied()` is set
+// if slot `i` holds a node.
+template <typename Node, std::size_t Capacity>
+class inline_slots {
+  static_assert(Capacity <= 64, "bimap: at most 64 inline nodes are supported");
+
+public:
+  inline_slots() noexcept = default;
+  inline_slots(const inline_slots&) = delete;
+  inline_slots& operator=(const inline_slots&) = delete;
+
+  std::uint64_t occupied() const noexcept {
+    return used;
+  }
+
+  void set_occupied(std::uint64_t mask) noexcept {
+    used = mask;
+  }
+
+  std::size_t size() const noexcept {
+    return static_cast<std::size_t>(std::popcount(used));
+  }
+
+  Node* storage(std::size_t index) noexcept {
+    return reinterpret_cast<Node*>(buffer + index * sizeof(Node));
+  }
+
+  Node* slot(std::size_t index) const noexcept {
+    return std::launder(const_cast<inline_slots*>(this)->storage(index));
+  }
+
+  bool owns(const Node* node) const noexcept {
+    const std::byte* address = reinterpret_cast<const std::byte*>(node);
+    std::less<const std::byte*> before;
+    return !before(address, buffer) && before(address, buffer + sizeof(buffer));
+  }
+
+  // Storage in the first free slot, or null if all of them are taken.
+  Node* allocate() noexcept {
+    if (size() == Capacity) {
+      return nullptr;
+    }
+    std::size_t index = static_cast<std::size_t>(std::countr_one(used));
+    used |= std::uint64_t(1) << index;
+    return storage(index);
+  }
+
+  void deallocate(Node* node) noexcept {
+    used &= ~(std::uint64_t(1) << index_of(node));
+  }
+
+  std::size_t index_of(const Node* node) const noexcept {
+    return static_cast<std::size_t>(reinterpret_cast<const std::byte*>(node) - buffer) / sizeof(Node);
+  }
+
+private:
+  alignas(Node) std::byte buffer[Capacity * sizeof(Node)];
+  std::uint64_t used = 0;
+};
+
+template <typename Node>
+class inline_slots<Node, 0> {
+public:
+  static constexpr std::size_t size() noexcept {
+    return 0;
+  }
+};
+
+// Open addressing from up to `capacity` nodes to indices, for passes that have to find a node met in one order
+// of a tree again in the other. Never grows and never forgets a node.
+template <typename Node>
+class index_table {
+public:
+  static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+  explicit index_table(std::size_t capacity)
+      : mask(std::bit_ceil(capacity * 2) - 1)
+      , shift(64 - std::bit_width(mask))
+      , entries(std::make_unique<entry[]>(mask + 1)) {}
+
+  void insert(const Node* node, std::size_t index) noexcept {
+    std::size_t i = slot_of(node);
+    while (entries[i].node) {
+      i = (i + 1) & mask;
+    }
+    entries[i] = {node, index};
+  }
+
+  std::size_t find(const Node* node) const noexcept {
+    for (std::size_t i = slot_of(node); entries[i].node; i = (i + 1) & mask) {
+      if (entries[i].node == node) {
+        return entries[i].index;
+      }
+    }
+    return none;
+  }
+
+private:
+  struct entry {
+    const Node* node = nullptr;
+    std::size_t index = 0;
+  };
+
+  // Fibonacci hashing: node addresses share their low bits, so the slot is taken from the high bits of the product.
+  std::size_t slot_of(const Node* node) const noexcept {
+    auto hash = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(node)) * 0x9E3779B97F4A7C15u;
+    return static_cast<std::size_t>(hash >> shift);
+  }
+
+  std::size_t mask;
+  int shift;
+  std::unique_ptr<entry[]> entries;
+};
+
+// Comparators that answer with `std::weak_ordering` or `std::strong_ordering` instead of `bool`.
+template <typename Compare, typename T>
+concept ordering_comparator = requires(const Compare& compare, const T& key) {
+  { compare(key, key) } -> std::convertible_to<std::weak_ordering>;
+};
+
+// `std::less` over a class type with `operator<=>` can be replaced by the latter: one call tells equality too.
+// Scalars are excluded, for them two plain comparisons are not slower than one three-way one.
+template <typename Compare, typename T>
+concept spaceship_less = !std::is_scalar_v<T> && std::three_way_comparable<T, std::weak_ordering>
+                      && (std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::less<>>);
+
+template <typename Compare, typename T>
+inline constexpr bool is_three_way_v = ordering_comparator<Compare, T> || spaceship_less<Compare, T>;
+
+// Arithmetic keys under `std::less` are compared inline, so a descent can pick the next child and
+// track its candidate with selects instead of branches.
+template <typename Compare, typename T>
+inline constexpr bool is_branchless_v =
+    std::is_arithmetic_v<T> && (std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::less<>>);
+
+// Comparators may opt into cached projections by providing `project(key)`, which maps a key to a cheap totally
+// ordered value consistent with the comparator: `project(a) < project(b)` must imply `compare(a, b)`,
+// and `compare(a, b)` must imply `!(project(b) < project(a))`. Each node stores the projections of its keys,
+// so descents compare those and only call the comparator for keys with equal projections.
+template <typename Compare, typename T>
+concept projecting_comparator = requires(const Compare& compare, const T& key) {
+  { compare.project(key) } -> std::totally_ordered;
+  requires std::semiregular<std::remove_cvref_t<decltype(compare.project(key))>>;
+  requires std::is_nothrow_copy_constructible_v<std::remove_cvref_t<decltype(compare.project(key))>>;
+  requires std::is_nothrow_copy_assignable_v<std::remove_cvref_t<decltype(compare.project(key))>>;
+};
+
+template <typename Compare, typename T>
+struct projection {
+  using type = no_projection;
+};
+
+template <typename Compare, typename T>
+  requires projecting_comparator<Compare, T>
+struct projection<Compare, T> {
+  using type = std::remove_cvref_t<decltype(std::declval<const Compare&>().project(std::declval<const T&>()))>;
+};
+
+template <typename Compare, typename T>
+using projection_t = typename projection<Compare, T>::type;
+
+// Whether a descent over keys of type `T` ordered by `Compare`, projections included, cannot throw.
+template <typename Compare, typename T>
+consteval bool nothrow_comparison() {
+  if constexpr (projecting_comparator<Compare, T>) {
+    if (!noexcept(std::declval<const projection_t<Compare, T>&>() < std::declval<const projection_t<Compare, T>&>())) {
+      return false;
+    }
+  }
+  if constexpr (is_branchless_v<Compare, T>) {
+    return true;
+  } else if constexpr (spaceship_less<Compare, T>) {
+    return noexcept(std::declval<const T&>() <=> std::declval<const T&>());
+  } else {
+    return std::is_nothrow_invocable_v<const Compare&, const T&, const T&>;
+  }
+}
+
+template <typename Compare, typename T>
+inline constexpr bool is_nothrow_comparison_v = nothrow_comparison<Compare, T>();
+
+template <typename Compare, typename Tag>
+struct comparator_holder {
+  [[no_unique_address]] Compare compare;
+};
+
+inline void prefetch(const void* address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address);
+#else
+  static_cast<void>(address);
+#endif
+}
+
+// What the coroutines run by a `lookup_scheduler` share. A chain of them, a task and the lookup it awaits,
+// has one place to store the coroutine that goes on when the chain is resumed: `resume_next` of the task,
+// which `current` of every coroutine in the chain points to.
+struct interleaved_promise {
+  std::coroutine_handle<> resume_next;
+  std::coroutine_handle<>* current = &resume_next;
+};
+
+// Awaited by a lookup before each node: stores where the lookup stopped and gives control back
+// to whoever resumed the chain.
+struct interleave_step {
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+    *handle.promise().current = handle;
+  }
+
+  void await_resume() const noexcept {}
+};
+
+// A lookup in progress, returned by `find_left_async` and `find_right_async`. Awaited by a task of
+// a `lookup_scheduler`, it runs interleaved with the lookups of other tasks. Awaited by any other coroutine
+// or read with `get`, it runs to the end at once.
+template <typename T>
+class lookup {
+public:
+  struct promise_type : interleaved_promise {
+    lookup get_return_object() noexcept {
+      return lookup(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() const noexcept {
+      return {};
+    }
+
+    auto final_suspend() const noexcept {
+      struct resume_awaiting {
+        bool await_ready() const noexcept {
+          return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+          promise_type& promise = handle.promise();
+          *promise.current = promise.continuation;
+          return promise.continuation;
+        }
+
+        void await_resume() const noexcept {}
+      };
+
+      return resume_awaiting{};
+    }
+
+    void return_value(T value) noexcept {
+      result = value;
+    }
+
+    void unhandled_exception() noexcept {
+      exception = std::current_exception();
+    }
+
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    T result;
+    std::exception_ptr exception;
+  };
+
+  lookup(lookup&& other) noexcept
+      : handle(std::exchange(other.handle, {})) {}
+
+  lookup& operator=(lookup&& other) noexcept {
+    lookup(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  ~lookup() {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  void swap(lookup& other) noexcept {
+    std::swap(handle, other.handle);
+  }
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  template <typename Promise>
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> awaiting) {
+    if constexpr (std::is_base_of_v<interleaved_promise, Promise>) {
+      handle.promise().current = awaiting.promise().current;
+      handle.promise().continuation = awaiting;
+      return handle;
+    } else {
+      run();
+      return awaiting;
+    }
+  }
+
+  T await_resume() const {
+    return result();
+  }
+
+  T get() {
+    run();
+    return result();
+  }
+
+private:
+  explicit lookup(std::coroutine_handle<promise_type> handle) noexcept
+      : handle(handle) {}
+
+  void run() {
+    while (!handle.done()) {
+      handle.resume();
+    }
+  }
+
+  T result() const {
+    if (handle.promise().exception) {
+      std::rethrow_exception(handle.promise().exception);
+    }
+    return handle.promise().result;
+  }
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+} // namespace bimap_details
+
+// Runs many coroutines on one thread, resuming each in turn up to its next suspension. A task that awaits
+// `find_left_async` or `find_right_async` suspends before every node the lookup visits, after asking for
+// the node to be prefetched, so the nodes that lookups of other tasks wait for load at the same time.
+//
+//   lookup_scheduler scheduler;
+//   for (auto& request : requests) {
+//     scheduler.spawn([](const auto& b, auto& request) -> lookup_scheduler::task {
+//       request.reply(co_await b.find_left_async(request.key));
+//     }(b, request));
+//   }
+//   scheduler.run();
+//
+// Tasks are spawned, not awaited. Whatever a task awaits other than a lookup suspends it until its next turn.
+class lookup_scheduler {
+public:
+  class task {
+  public:
+    struct promise_type : bimap_details::interleaved_promise {
+      task get_return_object() noexcept {
+        auto handle = std::coroutine_handle<promise_type>::from_promise(*this);
+        resume_next = handle;
+        return task(handle);
+      }
+
+      std::suspend_always initial_suspend() const noexcept {
+        return {};
+      }
+
+      std::suspend_always final_suspend() const noexcept {
+        return {};
+      }
+
+      void return_void() const noexcept {}
+
+      void unhandled_exception() noexcept {
+        exception = std::current_exception();
+      }
+
+      std::exception_ptr exception;
+    };
+
+    task(task&& other) noexcept
+        : handle(std::exchange(other.handle, {})) {}
+
+    task& operator=(task&& other) noexcept {
+      task(std::move(other)).swap(*this);
+      return *this;
+    }
+
+    ~task() {
+      if (handle) {
+        handle.destroy();
+      }
+    }
+
+    void swap(task& other) noexcept {
+      std::swap(handle, other.handle);
+    }
+
+  private:
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept
+        : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+
+    friend class lookup_scheduler;
+  };
+
+  lookup_scheduler() = default;
+
+  lookup_scheduler(const lookup_scheduler&) = delete;
+  lookup_scheduler& operator=(const lookup_scheduler&) = delete;
+
+  ~lookup_scheduler() {
+    for (auto handle : tasks) {
+      handle.destroy();
+    }
+  }
+
+  void spawn(task t) {
+    tasks.push_back(t.handle);
+    t.handle = {};
+  }
+
+  // Resumes the tasks in turn until all of them are done; tasks spawned meanwhile are run too. An exception
+  // that escapes a task is rethrown once the task is destroyed; the other tasks stay to be run again.
+  void run() {
+    while (!tasks.empty()) {
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < tasks.size(); ++i) {
+        auto handle = tasks[i];
+        handle.promise().resume_next.resume();
+        if (!handle.done()) {
+          tasks[kept++] = handle;
+          continue;
+        }
+        std::exception_ptr exception = std::move(handle.promise().exception);
+        handle.destroy();
+        if (exception) {
+          tasks.erase(tasks.begin() + kept, tasks.begin() + i + 1);
+          std::rethrow_exception(exception);
+        }
+      }
+      tasks.resize(kept);
+    }
+  }
+
+  std::size_t size() const noexcept {
+    return tasks.size();
+  }
+
+private:
+  std::vector<std::coroutine_handle<task::promise_type>> tasks;
+};
+
+// Representation options of a `bimap`. A policy is a struct with the members of `bimap_policy::standard`;
+// options can be combined by deriving from one of the policies below and redefining members.
+namespace bimap_policy {
+
+struct standard {
+  // Every node also links its in-order neighbours in both trees, so that an iterator step is one pointer hop
+  // and `begin` is constant time. Costs two more pointers per side and a few stores per insertion and erasure.
+  static constexpr bool threads = false;
+
+  // Links are 32-bit offsets and nodes live in one contiguous pool, which halves the per-pair overhead
+  // on 64-bit targets. Like `std::vector`, the pool is reallocated when it runs out of room, and that invalidates
+  // all iterators and references; `swap` and moves keep them valid. Not available together with `threads`.
+  static constexpr bool compact_links = false;
+
+  // Each side of a node, its tree links together with its key, starts a cache line of its own,
+  // so that a search in one tree does not pull the other side of the nodes it visits into the cache.
+  // Costs up to a cache line of padding per side.
+  static constexpr bool split_halves = false;
+
+  // The first nodes are placed into this many slots inside the bimap object, so that a bimap of up to that many
+  // pairs does not allocate, and while all pairs are there, lookups scan the slots instead of descending.
+  // Moving or swapping a bimap moves its inline nodes, which invalidates iterators and references to them;
+  // iterators to the other nodes stay valid as usual. Requires keys that can be moved without throwing
+  // and is not available together with `compact_links`.
+  static constexpr std::size_t inline_capacity = 0;
+
+  // A node inserted deeper than `height_factor * log2(size())` in one of the trees makes the lowest of its ancestors
+  // whose subtree is too tall for its own size get rebuilt as a balanced one, so sorted insertions do not degrade
+  // the tree into a list. Zero turns this off.
+  static constexpr std::size_t height_factor = 2;
+
+  // Lookups by key through a non-const bimap splay the found node to the root of its tree, so that frequently
+  // accessed keys are found in a few steps. Lookups through a const bimap do not change the structure, so they
+  // stay safe to run concurrently.
+  static constexpr bool self_adjusting = false;
+
+  // Every pair is stamped with the version at which it was inserted, and the last `change_log` erased pairs are kept,
+  // so that `changes_since` can list the pairs inserted and erased since an earlier `version()`. Costs two counters
+  // and two pointers per node, and erased nodes are freed once they drop out of the log. `replace_*` erases the old
+  // pair and inserts a new node, so it requires copyable keys. Not available together with `compact_links`
+  // or `inline_capacity`. Zero turns this off.
+  static constexpr std::size_t change_log = 0;
+};
+
+struct threaded : standard {
+  static constexpr bool threads = true;
+};
+
+struct compact : standard {
+  static constexpr bool compact_links = true;
+};
+
+struct split : standard {
+  static constexpr bool split_halves = true;
+};
+
+template <std::size_t N>
+struct small : standard {
+  static constexpr std::size_t inline_capacity = N;
+};
+
+struct splay : standard {
+  static constexpr bool self_adjusting = true;
+};
+
+template <std::size_t N>
+struct versioned : standard {
+  static constexpr std::size_t change_log = N;
+};
+
+} // namespace bimap_policy
+
+template <
+    typename Left,
+    typename Right,
+    typename CompareLeft = std::less<Left>,
+    typename CompareRight = std::less<Right>,
+    typename Policy = bimap_policy::standard>
 class bimap {
+  using left_tag = bimap_details::left_tag;
+  using right_tag = bimap_details::right_tag;
+  static_assert(!(Policy::threads && Policy::compact_links), "bimap: compact links cannot be threaded");
+
+  static constexpr bool compact = Policy::compact_links;
+
+  static constexpr std::size_t inline_capacity = Policy::inline_capacity;
+
+  static constexpr bool self_adjusting = Policy::self_adjusting;
+
+  static constexpr std::size_t change_log = Policy::change_log;
+
+  static constexpr bool tracks_changes = change_log > 0;
+
+  static_assert(!(compact && inline_capacity > 0), "bimap: compact links cannot reach inline nodes");
+  static_assert(
+      inline_capacity == 0 || (std::is_nothrow_move_constructible_v<Left> && std::is_nothrow_move_constructible_v<Right>),
+      "bimap: inline nodes are moved together with the bimap, which cannot throw"
+  );
+  static_assert(!(tracks_changes && (compact || inline_capacity > 0)), "bimap: a change log needs nodes that stay put");
+  static_assert(
+      !tracks_changes || (std::is_copy_constructible_v<Left> && std::is_copy_constructible_v<Right>),
+      "bimap: a change log keeps replaced pairs, which takes copyable keys"
+  );
+
+  using tree_node = std::conditional_t<
+      compact,
+      bimap_details::compact_tree_node,
+      std::conditional_t<Policy::threads, bimap_details::threaded_tree_node, bimap_details::tree_node>>;
+  using node_base = bimap_details::node_base<tree_node>;
+  using position = bimap_details::position<tree_node>;
+
+  template <typename Tag>
+  using opposite_tag = bimap_details::opposite_tag<Tag>;
+
+  template <typename Tag>
+  using key_t = std::conditional_t<std::is_same_v<Tag, left_tag>, Left, Right>;
+
+  template <typename Tag>
+  using compare_t = std::conditional_t<std::is_same_v<Tag, left_tag>, CompareLeft, CompareRight>;
+
+  template <typename Tag>
+  static constexpr bool three_way = bimap_details::is_three_way_v<compare_t<Tag>, key_t<Tag>>;
+
+  template <typename Tag>
+  static constexpr bool branchless = bimap_details::is_branchless_v<compare_t<Tag>, key_t<Tag>>;
+
+  template <typename Tag>
+  using projection_t = bimap_details::projection_t<compare_t<Tag>, key_t<Tag>>;
+
+  template <typename Tag>
+  static constexpr bool projected = bimap_details::projecting_comparator<compare_t<Tag>, key_t<Tag>>;
+
+  // Copy assignment may tear the target down and refill its nodes only if nothing after that can throw.
+  template <typename Tag>
+  static constexpr bool nothrow_refill =
+      std::is_nothrow_copy_constructible_v<key_t<Tag>> && std::is_nothrow_destructible_v<key_t<Tag>>
+      && std::is_nothrow_swappable_v<compare_t<Tag>> && bimap_details::is_nothrow_comparison_v<compare_t<Tag>, key_t<Tag>>;
+
+  static constexpr bool recycles_nodes = nothrow_refill<left_tag> && nothrow_refill<right_tag> && !tracks_changes;
+
+  // Key being searched for, together with its projection, so that the latter is computed once per operation.
+  template <typename Tag>
+  struct probe {
+    const key_t<Tag>& key;
+    [[no_unique_address]] projection_t<Tag> projection;
+  };
+
 public:
-  using left_t = void;
-  using right_t = void;
+  using left_t = Left;
+  using right_t = Right;
 
-  using node_t = void;
+private:
+  using stamp_t = std::conditional_t<tracks_changes, bimap_details::change_stamp, bimap_details::no_change_stamp>;
+
+public:
+  using node_t = std::conditional_t<
+      Policy::split_halves,
+      bimap_details::split_node<Left, Right, projection_t<left_tag>, projection_t<right_tag>, tree_node, stamp_t>,
+      bimap_details::node<Left, Right, projection_t<left_tag>, projection_t<right_tag>, tree_node, stamp_t>>;
 
-  class left_iterator;
-  class right_iterator;
+private:
+  using history_t = std::
+      conditional_t<tracks_changes, bimap_details::change_history<node_t>, bimap_details::no_change_history>;
 
-  class left_iterator {
+  using pool_t = std::conditional_t<compact, bimap_details::node_pool<node_t, node_base>, bimap_details::node_reserve<node_t>>;
+
+  template <typename Tag>
+  class basic_iterator {
   public:
-    const left_t& operator*() const;
-    const left_t* operator->() const;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = key_t<Tag>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    basic_iterator() = default;
+
+    reference operator*() const {
+      return node_t::template from<Tag>(node)->template key<Tag>();
+    }
 
-    left_iterator& operator++();
-    left_iterator operator++(int);
+    pointer operator->() const {
+      return std::addressof(**this);
+    }
 
-    left_iterator& operator--();
-    left_iterator operator--(int);
+    basic_iterator& operator++() {
+      node = bimap_details::step(node, 1);
+      return *this;
+    }
 
-    right_iterator flip() const;
+    basic_iterator operator++(int) {
+      basic_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    basic_iterator& operator--() {
+      node = bimap_details::step(node, 0);
+      return *this;
+    }
+
+    basic_iterator operator--(int) {
+      basic_iterator result = *this;
+      --*this;
+      return result;
+    }
+
+    basic_iterator<opposite_tag<Tag>> flip() const {
+      return basic_iterator<opposite_tag<Tag>>(node_t::template from<Tag>(node)->template as<opposite_tag<Tag>>());
+    }
+
+    friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) = default;
+
+  private:
+    explicit basic_iterator(tree_node* node)
+        : node(node) {}
+
+    tree_node* node = nullptr;
+
+    friend class bimap;
+    friend class basic_iterator<opposite_tag<Tag>>;
   };
 
 public:
-  bimap(CompareLeft compare_left = CompareLeft(), CompareRight compare_right = CompareRight());
+  using left_iterator = basic_iterator<left_tag>;
+  using right_iterator = basic_iterator<right_tag>;
+
+public:
+  bimap(CompareLeft compare_left = CompareLeft(), CompareRight compare_right = CompareRight())
+      : left_compare{std::move(compare_left)}
+      , right_compare{std::move(compare_right)} {}
+
+  // Builds a bimap from the pairs of `[first, last)`, as `insert_range` would.
+  template <std::input_iterator It, std::sentinel_for<It> S>
+  bimap(It first, S last, CompareLeft compare_left = CompareLeft(), CompareRight compare_right = CompareRight())
+      : bimap(std::move(compare_left), std::move(compare_right)) {
+    insert_range(first, last);
+  }
+
+  // Same, but both key orders are sorted with `policy` and the two trees are built concurrently if it allows.
+  // As with the standard parallel algorithms, a comparator that throws calls `std::terminate`.
+  template <typename ExecutionPolicy, std::forward_iterator It, std::sentinel_for<It> S>
+    requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+  bimap(
+      ExecutionPolicy&& policy,
+      It first,
+      S last,
+      CompareLeft compare_left = CompareLeft(),
+      CompareRight compare_right = CompareRight()
+  )
+      : bimap(std::move(compare_left), std::move(compare_right)) {
+    auto size = static_cast<std::size_t>(std::ranges::distance(first, last));
+    if (size > 0) {
+      insert_batch(policy, first, size);
+    }
+  }
+
+  bimap(const bimap& other)
+      : bimap(other.left_compare.compare, other.right_compare.compare) {
+    reserve_nodes(other.count);
+    copy_from(other, [this] { return allocate_node(); });
+  }
+
+  bimap(bimap&& other) noexcept
+      : left_compare{std::move(other.left_compare.compare)}
+      , right_compare{std::move(other.right_compare.compare)} {
+    steal(other);
+  }
+
+  bimap& operator=(const bimap& other) {
+    if (this != &other) {
+      if constexpr (recycles_nodes) {
+        refill_from(other);
+      } else {
+        bimap copy(other);
+        swap(*this, copy);
+        restart_history(copy);
+      }
+    }
+    return *this;
+  }
+
+  bimap& operator=(bimap&& other) noexcept {
+    if (this != &other) {
+      bimap moved(std::move(other));
+      swap(*this, moved);
+      restart_history(moved);
+    }
+    return *this;
+  }
+
+  ~bimap() {
+    tear_down([this](node_t* node) noexcept { destroy_node(node); });
+    if constexpr (tracks_changes) {
+      while (node_t* node = history.erased.oldest()) {
+        history.erased.remove(node);
+        destroy_node(node);
+      }
+    }
+  }
+
+  friend void swap(bimap& lhs, bimap& rhs) noexcept {
+    using std::swap;
+    swap(lhs.left_compare.compare, rhs.left_compare.compare);
+    swap(lhs.right_compare.compare, rhs.right_compare.compare);
+    swap(lhs.count, rhs.count);
+    swap(lhs.pool, rhs.pool);
+    if constexpr (!compact) {
+      swap_roots<left_tag>(lhs, rhs);
+      swap_roots<right_tag>(lhs, rhs);
+    }
+    if constexpr (inline_capacity > 0) {
+      swap_inline_nodes(lhs, rhs);
+    }
+    swap(lhs.history, rhs.history);
+  }
+
+  left_iterator insert(const left_t& left, const right_t& right) {
+    return insert_impl(left, right);
+  }
+
+  left_iterator insert(const left_t& left, right_t&& right) {
+    return insert_impl(left, std::move(right));
+  }
+
+  left_iterator insert(left_t&& left, const right_t& right) {
+    return insert_impl(std::move(left), right);
+  }
+
+  left_iterator insert(left_t&& left, right_t&& right) {
+    return insert_impl(std::move(left), std::move(right));
+  }
+
+  // Inserts the pairs of `[first, last)` in order, as `insert` would, and returns how many were inserted.
+  // A batch at least as large as the bimap is sorted by both keys instead, checked against the existing keys
+  // and within itself, and merged with the existing nodes into two rebuilt balanced trees in linear time.
+  // Smaller batches are inserted one by one, which touches fewer nodes than walking both trees in full.
+  template <std::input_iterator It, std::sentinel_for<It> S>
+  std::size_t insert_range(It first, S last) {
+    if constexpr (std::forward_iterator<It> || std::sized_sentinel_for<S, It>) {
+      auto size = static_cast<std::size_t>(std::ranges::distance(first, last));
+      if (size > 1 && size >= count) {
+        no_execution_policy sequential;
+        return insert_batch(sequential, first, size);
+      }
+    }
+    std::size_t inserted = 0;
+    for (; first != last; ++first) {
+      auto&& pair = *first;
+      using pair_t = decltype(pair);
+      auto it = insert(std::get<0>(std::forward<pair_t>(pair)), std::get<1>(std::forward<pair_t>(pair)));
+      if (it != end_left()) {
+        ++inserted;
+      }
+    }
+    return inserted;
+  }
+
+  // Constructs both keys right in the node from the arguments in `left_args` and `right_args`, then looks them up.
+  // If either key is taken, the node is destroyed and nothing is inserted.
+  template <typename... LeftArgs, typename... RightArgs>
+  left_iterator emplace(
+      std::piecewise_construct_t,
+      std::tuple<LeftArgs...> left_args,
+      std::tuple<RightArgs...> right_args
+  ) {
+    if constexpr (compact) {
+      if (needs_room()) {
+        // Built outside the pool first, so that a rejected pair does not grow it.
+        node_t staged(std::piecewise_construct, std::move(left_args), std::move(right_args));
+        fill_projection<left_tag>(&staged);
+        fill_projection<right_tag>(&staged);
+        if (find_position(node_probe<left_tag>(staged.template as<left_tag>())).found ||
+            find_position(node_probe<right_tag>(staged.template as<right_tag>())).found) {
+          return end_left();
+        }
+        make_room();
+        return insert_node(adopt_node(staged));
+      }
+    }
+    return insert_node(create_node(std::piecewise_construct, std::move(left_args), std::move(right_args)));
+  }
+
+  // Inserts `left` with the right key constructed in the node from `args`, which are left untouched
+  // if `left` is taken. Returns the end if either key is taken.
+  template <typename... Args>
+  left_iterator try_emplace_left(const left_t& left, Args&&... args) {
+    return try_emplace<left_tag>(left, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  left_iterator try_emplace_left(left_t&& left, Args&&... args) {
+    return try_emplace<left_tag>(std::move(left), std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  right_iterator try_emplace_right(const right_t& right, Args&&... args) {
+    return try_emplace<right_tag>(right, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  right_iterator try_emplace_right(right_t&& right, Args&&... args) {
+    return try_emplace<right_tag>(std::move(right), std::forward<Args>(args)...);
+  }
+
+  left_iterator erase_left(left_iterator it) {
+    return erase_at(it);
+  }
+
+  right_iterator erase_right(right_iterator it) {
+    return erase_at(it);
+  }
+
+  bool erase_left(const left_t& left) {
+    return erase_key<left_tag>(left);
+  }
+
+  bool erase_right(const right_t& right) {
+    return erase_key<right_tag>(right);
+  }
+
+  left_iterator erase_left(left_iterator first, left_iterator last) {
+    return erase_range(first, last);
+  }
+
+  right_iterator erase_right(right_iterator first, right_iterator last) {
+    return erase_range(first, last);
+  }
+
+  left_iterator find_left(const left_t& left) const {
+    return find<left_tag>(left);
+  }
+
+  right_iterator find_right(const right_t& right) const {
+    return find<right_tag>(right);
+  }
+
+  const right_t& at_left(const left_t& key) const {
+    return at<left_tag>(key);
+  }
+
+  const left_t& at_right(const right_t& key) const {
+    return at<right_tag>(key);
+  }
+
+  left_iterator find_left(const left_t& left)
+    requires self_adjusting
+  {
+    return found_or_end<left_tag>(promote<left_tag>(left));
+  }
+
+  right_iterator find_right(const right_t& right)
+    requires self_adjusting
+  {
+    return found_or_end<right_tag>(promote<right_tag>(right));
+  }
+
+  const right_t& at_left(const left_t& key)
+    requires self_adjusting
+  {
+    return partner<left_tag>(promote<left_tag>(key));
+  }
+
+  const left_t& at_right(const right_t& key)
+    requires self_adjusting
+  {
+    return partner<right_tag>(promote<right_tag>(key));
+  }
+
+  const right_t& at_left_or_default(const left_t& key)
+    requires std::is_default_constructible_v<right_t>
+  {
+    return at_or_default<left_tag>(key);
+  }
+
+  const left_t& at_right_or_default(const right_t& key)
+    requires std::is_default_constructible_v<left_t>
+  {
+    return at_or_default<right_tag>(key);
+  }
+
+  left_iterator replace_left(right_iterator it, left_t new_left) {
+    return replace<left_tag>(it, std::move(new_left));
+  }
+
+  right_iterator replace_right(left_iterator it, right_t new_right) {
+    return replace<right_tag>(it, std::move(new_right));
+  }
+
+  left_iterator lower_bound_left(const left_t& left) const {
+    return bound<left_tag, false>(left);
+  }
+
+  left_iterator upper_bound_left(const left_t& left) const {
+    return bound<left_tag, true>(left);
+  }
+
+  right_iterator lower_bound_right(const right_t& right) const {
+    return bound<right_tag, false>(right);
+  }
+
+  right_iterator upper_bound_right(const right_t& right) const {
+    return bound<right_tag, true>(right);
+  }
+
+  // Finger search variants: the search starts at `from` and costs about the logarithm of the distance
+  // between `from` and the result, instead of the height of the tree.
+
+  left_iterator find_left(left_iterator from, const left_t& left) const {
+    return find_from(from, left);
+  }
+
+  right_iterator find_right(right_iterator from, const right_t& right) const {
+    return find_from(from, right);
+  }
+
+  left_iterator lower_bound_left(left_iterator from, const left_t& left) const {
+    return bound_from<left_tag, false>(from.node, make_probe<left_tag>(left));
+  }
+
+  left_iterator upper_bound_left(left_iterator from, const left_t& left) const {
+    return bound_from<left_tag, true>(from.node, make_probe<left_tag>(left));
+  }
+
+  right_iterator lower_bound_right(right_iterator from, const right_t& right) const {
+    return bound_from<right_tag, false>(from.node, make_probe<right_tag>(right));
+  }
+
+  right_iterator upper_bound_right(right_iterator from, const right_t& right) const {
+    return bound_from<right_tag, true>(from.node, make_probe<right_tag>(right));
+  }
+
+  // Lookups to interleave with others on a `lookup_scheduler`: the descent suspends before each node it visits.
+  // The key must outlive the lookup, and the bimap must not change until the lookup is done.
+
+  bimap_details::lookup<left_iterator> find_left_async(const left_t& left) const {
+    return find_interleaved<left_tag>(left);
+  }
+
+  bimap_details::lookup<right_iterator> find_right_async(const right_t& right) const {
+    return find_interleaved<right_tag>(right);
+  }
+
+  // Batch lookups: writes `find_left(key)` for every key of `[first, last)` to `out` and returns the end
+  // of the output. The keys are split between threads as `policy` allows.
+
+  template <typename ExecutionPolicy, std::forward_iterator It, std::forward_iterator Out>
+    requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+  Out find_left(ExecutionPolicy&& policy, It first, It last, Out out) const {
+    return find_all<left_tag>(std::forward<ExecutionPolicy>(policy), first, last, out);
+  }
+
+  template <typename ExecutionPolicy, std::forward_iterator It, std::forward_iterator Out>
+    requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+  Out find_right(ExecutionPolicy&& policy, It first, It last, Out out) const {
+    return find_all<right_tag>(std::forward<ExecutionPolicy>(policy), first, last, out);
+  }
+
+  left_iterator begin_left() const {
+    return begin<left_tag>();
+  }
+
+  left_iterator end_left() const {
+    return end<left_tag>();
+  }
+
+  right_iterator begin_right() const {
+    return begin<right_tag>();
+  }
+
+  right_iterator end_right() const {
+    return end<right_tag>();
+  }
+
+  bool empty() const {
+    return count == 0;
+  }
+
+  void clear() noexcept {
+    if constexpr (compact && !tracks_changes) {
+      // The pool frees its slots all at once, so the nodes are only destroyed, and not even walked if trivial.
+      if constexpr (std::is_trivially_destructible_v<node_t>) {
+        forget_nodes();
+      } else {
+        tear_down([](node_t* node) noexcept { std::destroy_at(node); });
+      }
+      pool.reset();
+    } else {
+      tear_down([this](node_t* node) noexcept { release_node(node); });
+    }
+  }
+
+  std::size_t size() const {
+    return count;
+  }
+
+  // The number of changes made so far, to be passed to `changes_since` later.
+  std::uint64_t version() const noexcept
+    requires tracks_changes
+  {
+    return history.version;
+  }
+
+  // Calls `on_erased(left, right)` for every pair that was there at `since` and has been erased after it, then
+  // `on_inserted(left, right)` for every pair inserted after it, in the order of insertion, so that applying them
+  // in turn to a copy taken at `since` makes it equal to `*this`. Takes time proportional to the number of changes.
+  // Returns false without calling either if the change log does not reach back to `since`.
+  template <typename OnErased, typename OnInserted>
+  bool changes_since(std::uint64_t since, OnErased on_erased, OnInserted on_inserted) const
+    requires tracks_changes
+  {
+    if (since < history.horizon || since > history.version) {
+      return false;
+    }
+    using list = bimap_details::change_list<node_t>;
+    for (node_t* node = history.erased.newest(); node && node->erased > since; node = list::older(node)) {
+      if (node->inserted <= since) {
+        on_erased(std::as_const(node->template key<left_tag>()), std::as_const(node->template key<right_tag>()));
+      }
+    }
+    node_t* first = nullptr;
+    for (node_t* node = history.live.newest(); node && node->inserted > since; node = list::older(node)) {
+      first = node;
+    }
+    for (node_t* node = first; node; node = list::newer(node)) {
+      on_inserted(std::as_const(node->template key<left_tag>()), std::as_const(node->template key<right_tag>()));
+    }
+    return true;
+  }
+
+  // Makes sure that the next `n` insertions do not allocate. With compact links the node pool grows to fit them,
+  // which invalidates iterators.
+  void reserve(std::size_t n) {
+    if constexpr (compact) {
+      if (n > pool_t::max_capacity - count) {
+        throw std::length_error("bimap: compact node pool is full");
+      }
+      reserve_nodes(count + n);
+    } else {
+      std::size_t free_slots = inline_capacity - inline_nodes.size();
+      if (n > free_slots) {
+        pool.reserve(n - free_slots);
+      }
+    }
+  }
+
+  // Gives back the node storage set aside by `reserve`. With compact links the nodes are packed into a pool
+  // of exactly `size()` slots, which invalidates iterators.
+  void shrink_to_fit() {
+    if constexpr (compact) {
+      shrink_pool();
+    } else {
+      pool.release(0);
+    }
+  }
+
+  // The number of pairs the bimap can hold before an insertion allocates.
+  std::size_t capacity() const noexcept {
+    if constexpr (compact) {
+      return pool.capacity();
+    } else {
+      return count + pool.size() + (inline_capacity - inline_nodes.size());
+    }
+  }
+
+  // Rebuilds both trees as balanced ones in linear time. Iterators stay valid.
+  void rebalance() noexcept {
+    if (count > 0) {
+      rebuild_subtree(root<left_tag>(), count);
+      rebuild_subtree(root<right_tag>(), count);
+    }
+  }
+
+  friend bool operator==(const bimap& lhs, const bimap& rhs) {
+    if (lhs.count != rhs.count) {
+      return false;
+    }
+    for (auto l = lhs.begin_left(), r = rhs.begin_left(); l != lhs.end_left(); ++l, ++r) {
+      if (!lhs.equivalent<left_tag>(*l, *r) || !lhs.equivalent<right_tag>(*l.flip(), *r.flip())) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator!=(const bimap& lhs, const bimap& rhs) {
+    return !(lhs == rhs);
+  }
+
+  // Set operations on the pairs of two bimaps, equal as in `operator==`. They merge the left orders in lockstep
+  // and build both trees of the result balanced, which takes the comparators of `lhs`.
+
+  // The pairs of `lhs` and those of `rhs` whose keys are both missing from `lhs`, as if inserting `rhs` into `lhs`.
+  friend bimap set_union(const bimap& lhs, const bimap& rhs) {
+    return lhs.merge(rhs, set_operation::unite);
+  }
+
+  friend bimap set_intersection(const bimap& lhs, const bimap& rhs) {
+    return lhs.merge(rhs, set_operation::intersect);
+  }
+
+  friend bimap set_difference(const bimap& lhs, const bimap& rhs) {
+    return lhs.merge(rhs, set_operation::subtract);
+  }
+
+  // Applies a series of changes to a bimap all or nothing. Each change takes effect at once, as it would through
+  // the bimap itself, and goes to an undo log: inserted nodes, and erased nodes with their in-order successors,
+  // which stay allocated meanwhile. `commit` frees the erased nodes; `rollback`, also run by the destructor
+  // of an uncommitted transaction, undoes the changes in reverse order, relinking every erased node right before
+  // its successor without comparing keys. The bimap must not be changed other than through the transaction
+  // while it lasts. Erasures reach the change log, if any, on commit. Not available with compact links,
+  // since the pool may move the nodes that the log points to.
+  class transaction {
+  public:
+    explicit transaction(bimap& target) noexcept
+      requires(!compact)
+        : target(target) {}
+
+    transaction(const transaction&) = delete;
+    transaction& operator=(const transaction&) = delete;
+
+    ~transaction() {
+      rollback();
+    }
+
+    template <typename L, typename R>
+    left_iterator insert(L&& left, R&& right) {
+      reserve(1);
+      left_iterator it = target.insert(std::forward<L>(left), std::forward<R>(right));
+      if (it != target.end_left()) {
+        log.push_back({to_node<left_tag>(it.node), {}});
+      }
+      return it;
+    }
+
+    left_iterator erase_left(left_iterator it) {
+      return erase_at(it);
+    }
+
+    right_iterator erase_right(right_iterator it) {
+      return erase_at(it);
+    }
+
+    bool erase_left(const left_t& left) {
+      return erase_key<left_tag>(left);
+    }
+
+    bool erase_right(const right_t& right) {
+      return erase_key<right_tag>(right);
+    }
+
+    // Unlike `bimap::replace_*`, erases the old pair and inserts a fresh node, so the other key is copied.
+    left_iterator replace_left(right_iterator it, left_t new_left)
+      requires std::is_copy_constructible_v<right_t>
+    {
+      return replace<left_tag>(it, std::move(new_left));
+    }
+
+    right_iterator replace_right(left_iterator it, right_t new_right)
+      requires std::is_copy_constructible_v<left_t>
+    {
+      return replace<right_tag>(it, std::move(new_right));
+    }
+
+    void commit() noexcept {
+      for (const undo_entry& entry : log) {
+        if (entry.next[0]) {
+          target.release_node(entry.node);
+        }
+      }
+      log.clear();
+    }
+
+    void rollback() noexcept {
+      while (!log.empty()) {
+        undo_last();
+      }
+    }
+
+  private:
+    // An inserted node, or an erased one with its successors in both trees.
+    struct undo_entry {
+      node_t* node;
+      tree_node* next[2];
+    };
+
+    // Makes room in the log up front, so that a change, once made, is logged without throwing.
+    void reserve(std::size_t entries) {
+      if (log.capacity() - log.size() < entries) {
+        log.reserve(std::max(log.size() + entries, log.capacity() * 2));
+      }
+    }
+
+    void unlink(node_t* node) noexcept {
+      tree_node* left = node->template as<left_tag>();
+      tree_node* right = node->template as<right_tag>();
+      log.push_back({node, {bimap_details::step(left, 1), bimap_details::step(right, 1)}});
+      bimap_details::unlink(left);
+      bimap_details::unlink(right);
+      --target.count;
+    }
+
+    template <typename Tag>
+    basic_iterator<Tag> erase_at(basic_iterator<Tag> it) {
+      reserve(1);
+      basic_iterator<Tag> next = std::next(it);
+      unlink(to_node<Tag>(it.node));
+      return next;
+    }
+
+    template <typename Tag>
+    bool erase_key(const key_t<Tag>& key) {
+      tree_node* found = target.find_node<Tag>(target.make_probe<Tag>(key));
+      if (!found) {
+        return false;
+      }
+      reserve(1);
+      unlink(to_node<Tag>(found));
+      return true;
+    }
+
+    template <typename Tag>
+    basic_iterator<Tag> replace(basic_iterator<opposite_tag<Tag>> it, key_t<Tag>&& key) {
+      using other_tag = opposite_tag<Tag>;
+
+      reserve(2);
+      node_t* node = to_node<other_tag>(it.node);
+      probe<Tag> key_probe = target.make_probe<Tag>(key);
+      tree_node* found = target.find_node<Tag>(key_probe);
+      if (found && found != node->template as<Tag>()) {
+        return target.end<Tag>();
+      }
+      node_t* fresh = target.make_node<Tag>(
+          std::move(key),
+          std::as_const(node->template key<other_tag>()),
+          key_probe.projection,
+          node->template projection<other_tag>()
+      );
+      unlink(node);
+      try {
+        position left_pos = target.find_position(node_probe<left_tag>(fresh->template as<left_tag>()));
+        position right_pos = target.find_position(node_probe<right_tag>(fresh->template as<right_tag>()));
+        target.link_node(fresh, left_pos, right_pos);
+      } catch (...) {
+        target.destroy_node(fresh);
+        undo_last();
+        throw;
+      }
+      log.push_back({fresh, {}});
+      return basic_iterator<Tag>(fresh->template as<Tag>());
+    }
+
+    void undo_last() noexcept {
+      undo_entry entry = log.back();
+      log.pop_back();
+      if (entry.next[0]) {
+        bimap_details::link_before(entry.node->template as<left_tag>(), entry.next[0]);
+        bimap_details::link_before(entry.node->template as<right_tag>(), entry.next[1]);
+        ++target.count;
+      } else {
+        target.erase_node(entry.node);
+      }
+    }
+
+    bimap& target;
+    std::vector<undo_entry> log;
+  };
+
+private:
+  template <typename Tag>
+  tree_node* end_node() const noexcept {
+    if constexpr (compact) {
+      if (pool.sentinel()) {
+        return pool.sentinel()->template as<Tag>();
+      }
+    }
+    return const_cast<node_base&>(sentinel).template as<Tag>();
+  }
+
+  template <typename Tag>
+  tree_node* root() const noexcept {
+    return end_node<Tag>()->children[0];
+  }
+
+  template <typename Tag>
+  static node_t* to_node(tree_node* node) noexcept {
+    return node_t::template from<Tag>(node);
+  }
+
+  template <typename Tag>
+  static const key_t<Tag>& key_of(const tree_node* node) noexcept {
+    return node_t::template from<Tag>(node)->template key<Tag>();
+  }
+
+  template <typename Tag>
+  static const projection_t<Tag>& projection_of(const tree_node* node) noexcept {
+    return node_t::template from<Tag>(node)->template projection<Tag>();
+  }
+
+  template <typename Tag>
+  probe<Tag> make_probe(const key_t<Tag>& key) const {
+    if constexpr (projected<Tag>) {
+      return {key, comparator<Tag>().project(key)};
+    } else {
+      return {key, {}};
+    }
+  }
+
+  template <typename Tag>
+  static probe<Tag> node_probe(const tree_node* node) noexcept {
+    return {key_of<Tag>(node), projection_of<Tag>(node)};
+  }
+
+  template <typename Tag>
+  const compare_t<Tag>& comparator() const noexcept {
+    if constexpr (std::is_same_v<Tag, left_tag>) {
+      return left_compare.compare;
+    } else {
+      return right_compare.compare;
+    }
+  }
+
+  template <typename Tag>
+  std::weak_ordering compare(const key_t<Tag>& lhs, const key_t<Tag>& rhs) const
+    requires three_way<Tag>
+  {
+    if constexpr (bimap_details::spaceship_less<compare_t<Tag>, key_t<Tag>>) {
+      return lhs <=> rhs;
+    } else {
+      return comparator<Tag>()(lhs, rhs);
+    }
+  }
+
+  template <typename Tag>
+  bool less(const key_t<Tag>& lhs, const key_t<Tag>& rhs) const {
+    if constexpr (three_way<Tag>) {
+      return std::is_lt(compare<Tag>(lhs, rhs));
+    } else {
+      return comparator<Tag>()(lhs, rhs);
+    }
+  }
+
+  template <typename Tag>
+  bool equivalent(const key_t<Tag>& lhs, const key_t<Tag>& rhs) const {
+    if constexpr (three_way<Tag>) {
+      return std::is_eq(compare<Tag>(lhs, rhs));
+    } else {
+      return !less<Tag>(lhs, rhs) && !less<Tag>(rhs, lhs);
+    }
+  }
+
+  // Comparisons of a probe with a stored key. Projections decide unless they are equal.
+
+  template <typename Tag>
+  std::weak_ordering compare(const probe<Tag>& lhs, const tree_node* rhs) const
+    requires three_way<Tag>
+  {
+    if constexpr (projected<Tag>) {
+      if (lhs.projection < projection_of<Tag>(rhs)) {
+        return std::weak_ordering::less;
+      }
+      if (projection_of<Tag>(rhs) < lhs.projection) {
+        return std::weak_ordering::greater;
+      }
+    }
+    return compare<Tag>(lhs.key, key_of<Tag>(rhs));
+  }
+
+  template <typename Tag>
+  bool precedes(const probe<Tag>& lhs, const tree_node* rhs) const {
+    if constexpr (projected<Tag>) {
+      if (lhs.projection < projection_of<Tag>(rhs)) {
+        return true;
+      }
+      if (projection_of<Tag>(rhs) < lhs.projection) {
+        return false;
+      }
+    }
+    return less<Tag>(lhs.key, key_of<Tag>(rhs));
+  }
+
+  template <typename Tag>
+  bool follows(const probe<Tag>& lhs, const tree_node* rhs) const {
+    if constexpr (projected<Tag>) {
+      if (projection_of<Tag>(rhs) < lhs.projection) {
+        return true;
+      }
+      if (lhs.projection < projection_of<Tag>(rhs)) {
+        return false;
+      }
+    }
+    return less<Tag>(key_of<Tag>(rhs), lhs.key);
+  }
+
+  // Single descent that finds both the equivalent node (if any) and the slot for insertion.
+  // With a three-way comparison it is one call per level and stops at the match,
+  // otherwise one call per level plus one at the end to tell equality.
+  template <typename Tag>
+  position find_position(const probe<Tag>& key) const {
+    position pos{end_node<Tag>(), 0, nullptr, 0};
+    if constexpr (three_way<Tag>) {
+      for (tree_node* cur = root<Tag>(); cur; cur = cur->children[pos.dir]) {
+        pos.parent = cur;
+        ++pos.depth;
+        std::weak_ordering order = compare<Tag>(key, cur);
+        if (std::is_eq(order)) {
+          pos.found = cur;
+          break;
+        }
+        pos.dir = std::is_gt(order);
+      }
+    } else if constexpr (branchless<Tag>) {
+      const key_t<Tag> value = key.key;
+      tree_node* candidate = nullptr;
+      for (tree_node* cur = root<Tag>(); cur; cur = cur->children[pos.dir]) {
+        pos.parent = cur;
+        ++pos.depth;
+        pos.dir = !(value < key_of<Tag>(cur));
+        candidate = pos.dir ? cur : candidate;
+      }
+      if (candidate && !(key_of<Tag>(candidate) < value)) {
+        pos.found = candidate;
+      }
+    } else {
+      tree_node* candidate = nullptr;
+      for (tree_node* cur = root<Tag>(); cur; cur = cur->children[pos.dir]) {
+        pos.parent = cur;
+        ++pos.depth;
+        pos.dir = !precedes<Tag>(key, cur);
+        if (pos.dir) {
+          candidate = cur;
+        }
+      }
+      if (candidate && !follows<Tag>(key, candidate)) {
+        pos.found = candidate;
+      }
+    }
+    return pos;
+  }
+
+  // The node with a key equivalent to `key`, or null. While all nodes are inline, the slots are scanned instead.
+  template <typename Tag>
+  tree_node* find_node(const probe<Tag>& key) const {
+    if constexpr (inline_capacity > 0) {
+      if (count == inline_nodes.size()) {
+        for (std::uint64_t used = inline_nodes.occupied(); used; used &= used - 1) {
+          tree_node* cur = inline_nodes.slot(static_cast<std::size_t>(std::countr_zero(used)))->template as<Tag>();
+          if constexpr (three_way<Tag>) {
+            if (std::is_eq(compare<Tag>(key, cur))) {
+              return cur;
+            }
+          } else if (!precedes<Tag>(key, cur) && !follows<Tag>(key, cur)) {
+            return cur;
+          }
+        }
+        return nullptr;
+      }
+    }
+    return find_position(key).found;
+  }
+
+  template <typename Tag>
+  basic_iterator<Tag> find(const key_t<Tag>& key) const {
+    return found_or_end<Tag>(find_node<Tag>(make_probe<Tag>(key)));
+  }
+
+  template <typename Tag>
+  const key_t<opposite_tag<Tag>>& at(const key_t<Tag>& key) const {
+    return partner<Tag>(find_node<Tag>(make_probe<Tag>(key)));
+  }
+
+  // The node with a key equivalent to `key`, splayed to the root of its tree, or null.
+  template <typename Tag>
+  tree_node* promote(const key_t<Tag>& key) {
+    tree_node* found = find_node<Tag>(make_probe<Tag>(key));
+    if (found) {
+      bimap_details::splay(found, end_node<Tag>());
+    }
+    return found;
+  }
+
+  template <typename Tag>
+  basic_iterator<Tag> found_or_end(tree_node* found) const {
+    return basic_iterator<Tag>(found ? found : end_node<Tag>());
+  }
+
+  template <typename Tag>
+  static const key_t<opposite_tag<Tag>>& partner(tree_node* found) {
+    if (!found) {
+      throw std::out_of_range("bimap: key not found");
+    }
+    return to_node<Tag>(found)->template key<opposite_tag<Tag>>();
+  }
+
+  // Returns the first node that goes after `key` (`Upper`) or does not go before it (`!Upper`).
+  template <typename Tag, bool Upper>
+  basic_iterator<Tag> bound(const key_t<Tag>& key) const {
+    return bound_below<Tag, Upper>(make_probe<Tag>(key), root<Tag>(), end_node<Tag>());
+  }
+
+  // The same as `bound`, but the descent starts at `cur`. The answer is in the subtree of `cur` unless it is `result`.
+  template <typename Tag, bool Upper>
+  basic_iterator<Tag> bound_below(const probe<Tag>& key, tree_node* cur, tree_node* result) const {
+    if constexpr (branchless<Tag>) {
+      const key_t<Tag> value = key.key;
+      for (; cur;) {
+        bool go_left = Upper ? value < key_of<Tag>(cur) : !(key_of<Tag>(cur) < value);
+        result = go_left ? cur : result;
+        cur = cur->children[!go_left];
+      }
+    } else {
+      for (; cur;) {
+        bool go_left;
+        if constexpr (three_way<Tag>) {
+          std::weak_ordering order = compare<Tag>(key, cur);
+          if (std::is_eq(order)) {
+            return basic_iterator<Tag>(Upper ? bimap_details::step(cur, 1) : cur);
+          }
+          go_left = std::is_lt(order);
+        } else {
+          go_left = Upper ? precedes<Tag>(key, cur) : !follows<Tag>(key, cur);
+        }
+        if (go_left) {
+          result = cur;
+        }
+        cur = cur->children[!go_left];
+      }
+    }
+    return basic_iterator<Tag>(result);
+  }
+
+  // Finger search: climbs from `from` only until an ancestor bounds the answer, then descends into the subtree
+  // in between. Both phases stay below the lowest common ancestor of `from` and the answer, so the cost depends on
+  // the distance between them rather than on the height of the tree. Starting from the end works like starting
+  // from the last node.
+  template <typename Tag, bool Upper>
+  basic_iterator<Tag> bound_from(tree_node* from, const probe<Tag>& key) const {
+    tree_node* end = end_node<Tag>();
+    if (from == end) {
+      if (!root<Tag>()) {
+        return basic_iterator<Tag>(end);
+      }
+      from = bimap_details::step(end, 0);
+    }
+    // If `from` goes before the answer, the answer is to its right, otherwise it is `from` or to its left.
+    // Only the ancestors in that direction are compared with. Between `fence`, the last node passed on the way,
+    // and the next such ancestor lie exactly the nodes of the subtree of `fence` on that side.
+    bool after = goes_before_bound<Tag, Upper>(key, from);
+    tree_node* fence = from;
+    tree_node* result = after ? end : from;
+    for (tree_node *cur = from, *parent = cur->parent; parent != end; cur = parent, parent = cur->parent) {
+      if (parent->children[!after] != cur) {
+        continue;
+      }
+      if (goes_before_bound<Tag, Upper>(key, parent) != after) {
+        if (after) {
+          result = parent;
+        }
+        break;
+      }
+      fence = parent;
+      if (!after) {
+        result = parent;
+      }
+    }
+    return bound_below<Tag, Upper>(key, fence->children[after], result);
+  }
+
+  // Whether `node` goes before the result of `bound<Tag, Upper>(key)`.
+  template <typename Tag, bool Upper>
+  bool goes_before_bound(const probe<Tag>& key, const tree_node* node) const {
+    return Upper ? !precedes<Tag>(key, node) : follows<Tag>(key, node);
+  }
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+// GCC 12 warns about a null pointer constant in the code it generates for every coroutine.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+
+  // The descent of `find_position`, prefetching each node and suspending before it is compared with.
+  template <typename Tag>
+  bimap_details::lookup<basic_iterator<Tag>> find_interleaved(const key_t<Tag>& k) const {
+    if constexpr (inline_capacity > 0) {
+      if (count == inline_nodes.size()) {
+        co_return find<Tag>(k);
+      }
+    }
+    probe<Tag> key = make_probe<Tag>(k);
+    tree_node* candidate = nullptr;
+    for (tree_node* cur = root<Tag>(); cur;) {
+      bimap_details::prefetch(cur);
+      bimap_details::prefetch(&key_of<Tag>(cur));
+      co_await bimap_details::interleave_step{};
+      bool dir;
+      if constexpr (three_way<Tag>) {
+        std::weak_ordering order = compare<Tag>(key, cur);
+        if (std::is_eq(order)) {
+          co_return basic_iterator<Tag>(cur);
+        }
+        dir = std::is_gt(order);
+      } else {
+        dir = !precedes<Tag>(key, cur);
+        if (dir) {
+          candidate = cur;
+        }
+      }
+      cur = cur->children[dir];
+    }
+    if (candidate && !follows<Tag>(key, candidate)) {
+      co_return basic_iterator<Tag>(candidate);
+    }
+    co_return end<Tag>();
+  }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic pop
+#endif
+
+  template <typename Tag, typename ExecutionPolicy, typename It, typename Out>
+  Out find_all(ExecutionPolicy&& policy, It first, It last, Out out) const {
+    return std::transform(std::forward<ExecutionPolicy>(policy), first, last, out, [this](const key_t<Tag>& k) {
+      return find<Tag>(k);
+    });
+  }
+
+  template <typename Tag>
+  basic_iterator<Tag> find_from(basic_iterator<Tag> from, const key_t<Tag>& k) const {
+    probe<Tag> key = make_probe<Tag>(k);
+    basic_iterator<Tag> it = bound_from<Tag, false>(from.node, key);
+    if (it.node == end_node<Tag>() || precedes<Tag>(key, it.node)) {
+      return end<Tag>();
+    }
+    return it;
+  }
+
+  template <typename Tag>
+  basic_iterator<Tag> begin() const {
+    return basic_iterator<Tag>(bimap_details::first(end_node<Tag>()));
+  }
+
+  template <typename Tag>
+  basic_iterator<Tag> end() const {
+    return basic_iterator<Tag>(end_node<Tag>());
+  }
+
+  node_t* allocate_node() {
+    if constexpr (compact) {
+      return pool.allocate();
+    } else {
+      if constexpr (inline_capacity > 0) {
+        if (node_t* node = inline_nodes.allocate()) {
+          return node;
+        }
+      }
+      return pool.allocate();
+    }
+  }
+
+  void deallocate_node(node_t* node) noexcept {
+    if constexpr (compact) {
+      pool.deallocate(node);
+    } else {
+      if constexpr (inline_capacity > 0) {
+        if (inline_nodes.owns(node)) {
+          inline_nodes.deallocate(node);
+          return;
+        }
+      }
+      pool.deallocate(node);
+    }
+  }
+
+  // Like `deallocate_node`, but heap storage is kept in the reserve.
+  void recycle_node(node_t* node) noexcept
+    requires(!compact)
+  {
+    if constexpr (inline_capacity > 0) {
+      if (inline_nodes.owns(node)) {
+        inline_nodes.deallocate(node);
+        return;
+      }
+    }
+    pool.recycle(node);
+  }
+
+  // Builds a node in `storage`, which is released if a key constructor throws.
+  template <typename... Args>
+  node_t* construct_node(node_t* storage, Args&&... args) {
+    try {
+      return std::construct_at(storage, std::forward<Args>(args)...);
+    } catch (...) {
+      deallocate_node(storage);
+      throw;
+    }
+  }
+
+  template <typename... Args>
+  node_t* create_node(Args&&... args) {
+    return construct_node(allocate_node(), std::forward<Args>(args)...);
+  }
+
+  // A node of `*this` with the keys of `staged`, a node built elsewhere, moved over if that cannot throw.
+  node_t* adopt_node(node_t& staged) {
+    return create_node(
+        std::move_if_noexcept(staged.template key<left_tag>()),
+        std::move_if_noexcept(staged.template key<right_tag>()),
+        staged.template projection<left_tag>(),
+        staged.template projection<right_tag>()
+    );
+  }
+
+  void destroy_node(node_t* node) noexcept {
+    std::destroy_at(node);
+    deallocate_node(node);
+  }
+
+  void note_inserted(node_t* node) noexcept {
+    if constexpr (tracks_changes) {
+      node->inserted = ++history.version;
+      node->erased = 0;
+      history.live.push(node);
+    }
+  }
+
+  // Disposes of a node unlinked from both trees: with a change log, it joins the erased pairs,
+  // and the oldest one is freed once there are too many.
+  void release_node(node_t* node) noexcept {
+    if constexpr (tracks_changes) {
+      history.live.remove(node);
+      node->erased = ++history.version;
+      history.erased.push(node);
+      if (history.erased.size() > change_log) {
+        node_t* oldest = history.erased.oldest();
+        history.erased.remove(oldest);
+        history.horizon = oldest->erased;
+        destroy_node(oldest);
+      }
+    } else {
+      destroy_node(node);
+    }
+  }
+
+  // Called on `*this` after it has taken over the pairs and history of `other`, or lost them to it: no follower
+  // of either bimap may take a later version of `*this` for one it has seen.
+  void restart_history(const bimap& other) noexcept {
+    if constexpr (tracks_changes) {
+      history.version = std::max(history.version, other.history.version) + 1;
+      history.horizon = history.version;
+    }
+  }
+
+  template <typename Tag, typename K, typename O>
+  node_t* make_node(
+      K&& key,
+      O&& other,
+      const projection_t<Tag>& key_projection,
+      const projection_t<opposite_tag<Tag>>& other_projection
+  ) {
+    if constexpr (std::is_same_v<Tag, left_tag>) {
+      return create_node(std::forward<K>(key), std::forward<O>(other), key_projection, other_projection);
+    } else {
+      return create_node(std::forward<O>(other), std::forward<K>(key), other_projection, key_projection);
+    }
+  }
+
+  void link_node(node_t* node, position left_pos, position right_pos) noexcept {
+    bimap_details::link(node->template as<left_tag>(), left_pos.parent, left_pos.dir);
+    bimap_details::link(node->template as<right_tag>(), right_pos.parent, right_pos.dir);
+    ++count;
+    note_inserted(node);
+    check_height<left_tag>(node->template as<left_tag>(), left_pos.depth);
+    check_height<right_tag>(node->template as<right_tag>(), right_pos.depth);
+  }
+
+  template <typename L, typename R>
+  left_iterator insert_impl(L&& left, R&& right) {
+    probe<left_tag> left_key = make_probe<left_tag>(left);
+    position left_pos = find_position(left_key);
+    if (left_pos.found) {
+      return end_left();
+    }
+    probe<right_tag> right_key = make_probe<right_tag>(right);
+    position right_pos = find_position(right_key);
+    if (right_pos.found) {
+      return end_left();
+    }
+    if (needs_room()) {
+      make_room();
+      left_pos = find_position(left_key);
+      right_pos = find_position(right_key);
+    }
+    node_t* node = create_node(std::forward<L>(left), std::forward<R>(right), left_key.projection, right_key.projection);
+    link_node(node, left_pos, right_pos);
+    return left_iterator(node->template as<left_tag>());
+  }
+
+  // The depth that a tree of `size` nodes may reach before a part of it is rebuilt, or the maximum if never.
+  static std::size_t height_limit(std::size_t size) noexcept {
+    if constexpr (Policy::height_factor == 0) {
+      return std::numeric_limits<std::size_t>::max();
+    } else {
+      return Policy::height_factor * static_cast<std::size_t>(std::bit_width(size));
+    }
+  }
+
+  // Scapegoat check after `links` has been linked at `depth`. If it is too deep, one of its ancestors roots a subtree
+  // that is too tall for its own size: the root itself at the latest. The lowest such subtree is rebuilt.
+  // Sizes are summed on the way up, each level adding the nodes of the sibling subtree.
+  template <typename Tag>
+  void check_height(tree_node* links, std::size_t depth) noexcept {
+    if (depth <= height_limit(count)) {
+      return;
+    }
+    tree_node* end = end_node<Tag>();
+    std::size_t size = 1;
+    std::size_t height = 0;
+    for (tree_node* cur = links; cur->parent != end; cur = cur->parent) {
+      tree_node* parent = cur->parent;
+      size += 1 + subtree_size(parent->children[parent->children[0] == cur]);
+      if (++height > height_limit(size)) {
+        rebuild_subtree(parent, size);
+        return;
+      }
+    }
+  }
+
+  static std::size_t subtree_size(tree_node* root) noexcept {
+    if (!root) {
+      return 0;
+    }
+    std::size_t size = 1;
+    for (tree_node *cur = bimap_details::extreme(root, 0), *last = bimap_details::extreme(root, 1); cur != last;
+         cur = bimap_details::step(cur, 1)) {
+      ++size;
+    }
+    return size;
+  }
+
+  // Replaces the subtree of `root`, which has `size` nodes, with a balanced one. The in-order sequence
+  // stays the same, so the threads are left alone.
+  static void rebuild_subtree(tree_node* root, std::size_t size) noexcept {
+    tree_node* parent = root->parent;
+    int dir = parent->children[0] != root;
+    tree_node* head = bimap_details::extreme(root, 0);
+    tree_node* cur = head;
+    for (std::size_t i = 1; i < size; ++i) {
+      tree_node* next = bimap_details::step(cur, 1);
+      cur->children[0] = next;
+      cur = next;
+    }
+    cur->children[0] = nullptr;
+    tree_node* rebuilt = bimap_details::build_balanced(head, size);
+    parent->children[dir] = rebuilt;
+    rebuilt->parent = parent;
+  }
+
+  // A pair of a batch passed to `insert_range`. `next` is the existing node that the key goes right before,
+  // `group` numbers the distinct keys of the batch in order, and `exists` tells if the key is already taken.
+  // Both are per side. The node of a pair that is not inserted is destroyed and reset to null.
+  struct batch_entry {
+    node_t* node;
+    tree_node* next[2];
+    std::size_t group[2];
+    bool exists[2];
+  };
+
+  // An entry in key order. The node is copied next to it, so that sorting reaches the keys in one step.
+  struct batch_ref {
+    node_t* node;
+    batch_entry* entry;
+  };
+
+  // Stands for the plain sequential algorithms, which, unlike `std::execution::seq`, let exceptions through.
+  struct no_execution_policy {};
+
+  template <typename ExecutionPolicy>
+  static constexpr bool is_parallel = std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>;
+
+  template <typename ExecutionPolicy, typename It, typename Compare>
+  static void sort(ExecutionPolicy& policy, It first, It last, Compare compare) {
+    if constexpr (is_parallel<ExecutionPolicy>) {
+      std::sort(policy, first, last, compare);
+    } else {
+      std::sort(first, last, compare);
+    }
+  }
+
+  // Calls `f(left_tag())` and `f(right_tag())`, concurrently if `policy` allows.
+  template <typename ExecutionPolicy, typename F>
+  static void for_each_side(ExecutionPolicy& policy, F f) {
+    if constexpr (is_parallel<ExecutionPolicy>) {
+      constexpr bool sides[] = {false, true};
+      std::for_each(policy, std::begin(sides), std::end(sides), [&f](bool right) {
+        right ? f(right_tag()) : f(left_tag());
+      });
+    } else {
+      f(left_tag());
+      f(right_tag());
+    }
+  }
+
+  // Every step that may throw, building the nodes and comparing keys, comes before the trees are touched,
+  // so a throw leaves the bimap intact. The two sides of a batch touch disjoint fields of the entries and
+  // disjoint links of the nodes, so `policy` may classify and merge them concurrently.
+  //
+  // A compact bimap short of room builds the batch in a pool of its own, and only the nodes that go in are moved
+  // over once the pool has grown for them, so that a batch that inserts nothing leaves iterators valid.
+  template <typename ExecutionPolicy, typename It>
+  std::size_t insert_batch(ExecutionPolicy& policy, It first, std::size_t size) {
+    pool_t staging;
+    bool staged = false;
+    if constexpr (compact) {
+      if (size > pool_t::max_capacity - count) {
+        throw std::length_error("bimap: compact node pool is full");
+      }
+      if (count + size > pool.capacity()) {
+        pool_t fresh(size);
+        swap(staging, fresh);
+        staged = true;
+      }
+    }
+    auto entries = std::make_unique_for_overwrite<batch_entry[]>(size);
+    auto left_order = std::make_unique_for_overwrite<batch_ref[]>(size);
+    auto right_order = std::make_unique_for_overwrite<batch_ref[]>(size);
+    auto group_used = std::make_unique<bool[]>(2 * size);
+    std::size_t built = 0;
+    auto destroy_staging = [&staging, &built]() noexcept {
+      if constexpr (compact) {
+        for (std::size_t i = 0; i < built; ++i) {
+          std::destroy_at(staging.slot(i));
+        }
+      }
+    };
+    try {
+      for (; built < size; ++first) {
+        auto&& pair = *first;
+        using pair_t = decltype(pair);
+        node_t* node;
+        if constexpr (compact) {
+          if (staged) {
+            node = std::construct_at(
+                staging.slot(built),
+                std::get<0>(std::forward<pair_t>(pair)),
+                std::get<1>(std::forward<pair_t>(pair))
+            );
+          } else {
+            node = create_node(std::get<0>(std::forward<pair_t>(pair)), std::get<1>(std::forward<pair_t>(pair)));
+          }
+        } else {
+          node = create_node(std::get<0>(std::forward<pair_t>(pair)), std::get<1>(std::forward<pair_t>(pair)));
+        }
+        entries[built++].node = node;
+        fill_projection<left_tag>(node);
+        fill_projection<right_tag>(node);
+      }
+      for_each_side(policy, [&]<typename Tag>(Tag) {
+        classify_batch<Tag>(policy, entries.get(), (std::is_same_v<Tag, left_tag> ? left_order : right_order).get(), size);
+      });
+    } catch (...) {
+      if (staged) {
+        destroy_staging();
+      } else {
+        for (std::size_t i = 0; i < built; ++i) {
+          destroy_node(entries[i].node);
+        }
+      }
+      throw;
+    }
+
+    std::size_t inserted = 0;
+    bool* left_used = group_used.get();
+    bool* right_used = group_used.get() + size;
+    for (std::size_t i = 0; i < size; ++i) {
+      batch_entry& entry = entries[i];
+      if (entry.exists[0] || entry.exists[1] || left_used[entry.group[0]] || right_used[entry.group[1]]) {
+        if (!staged) {
+          destroy_node(entry.node);
+        }
+        entry.node = nullptr;
+        continue;
+      }
+      left_used[entry.group[0]] = true;
+      right_used[entry.group[1]] = true;
+      ++inserted;
+    }
+    if constexpr (compact) {
+      if (staged) {
+        // Growing moves the existing nodes and the sentinels to the same indices of a new pool, so the places found
+        // for the batch are held as indices meanwhile.
+        constexpr std::size_t at_end = std::numeric_limits<std::size_t>::max();
+        std::size_t adopted = 0;
+        try {
+          auto places = std::make_unique_for_overwrite<std::size_t[]>(2 * size);
+          auto save_places = [&]<typename Tag>(Tag) {
+            constexpr int side = std::is_same_v<Tag, right_tag>;
+            for (std::size_t i = 0; i < size; ++i) {
+              tree_node* next = entries[i].next[side];
+              places[2 * i + side] = next == end_node<Tag>() ? at_end : pool.index_of(to_node<Tag>(next));
+            }
+          };
+          auto restore_places = [&]<typename Tag>(Tag) {
+            constexpr int side = std::is_same_v<Tag, right_tag>;
+            for (std::size_t i = 0; i < size; ++i) {
+              std::size_t place = places[2 * i + side];
+              entries[i].next[side] = place == at_end ? end_node<Tag>() : pool.slot(place)->template as<Tag>();
+            }
+          };
+          save_places(left_tag());
+          save_places(right_tag());
+          reserve_nodes(count + inserted);
+          restore_places(left_tag());
+          restore_places(right_tag());
+          for (; adopted < size; ++adopted) {
+            if (node_t*& node = entries[adopted].node) {
+              node = adopt_node(*node);
+            }
+          }
+        } catch (...) {
+          for (std::size_t i = 0; i < adopted; ++i) {
+            if (entries[i].node) {
+              destroy_node(entries[i].node);
+            }
+          }
+          destroy_staging();
+          throw;
+        }
+        destroy_staging();
+      }
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+      if (entries[i].node) {
+        note_inserted(entries[i].node);
+      }
+    }
+    for_each_side(policy, [&]<typename Tag>(Tag) {
+      merge_batch<Tag>((std::is_same_v<Tag, left_tag> ? left_order : right_order).get(), size, count + inserted);
+    });
+    count += inserted;
+    return inserted;
+  }
+
+  // Sorts the batch by its `Tag` keys into `order` and fills in the `Tag` side of the entries. The existing
+  // keys are looked up with finger searches that start from the previous result.
+  template <typename Tag, typename ExecutionPolicy>
+  void classify_batch(ExecutionPolicy& policy, batch_entry* entries, batch_ref* order, std::size_t size) const {
+    constexpr int side = std::is_same_v<Tag, right_tag>;
+    for (std::size_t i = 0; i < size; ++i) {
+      order[i] = {entries[i].node, entries + i};
+    }
+    sort(policy, order, order + size, [this](const batch_ref& lhs, const batch_ref& rhs) {
+      return less<Tag>(lhs.node->template key<Tag>(), rhs.node->template key<Tag>());
+    });
+
+    tree_node* end = end_node<Tag>();
+    tree_node* cur = bimap_details::first(end);
+    std::size_t group = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+      batch_entry& entry = *order[i].entry;
+      probe<Tag> key = node_probe<Tag>(entry.node->template as<Tag>());
+      if (i > 0 && follows<Tag>(key, order[i - 1].node->template as<Tag>())) {
+        ++group;
+      }
+      cur = bound_from<Tag, false>(cur, key).node;
+      entry.next[side] = cur;
+      entry.group[side] = group;
+      entry.exists[side] = cur != end && !precedes<Tag>(key, cur);
+    }
+  }
+
+  // Rebuilds the `Tag` tree from its nodes merged with the inserted nodes of the batch, `total` in all.
+  template <typename Tag>
+  void merge_batch(const batch_ref* order, std::size_t size, std::size_t total) noexcept {
+    constexpr int side = std::is_same_v<Tag, right_tag>;
+    tree_node* end = end_node<Tag>();
+    tree_node* list = nullptr;
+    tree_node* tail = nullptr;
+    auto append = [&list, &tail](tree_node* links) {
+      if (tail) {
+        tail->children[0] = links;
+      } else {
+        list = links;
+      }
+      tail = links;
+    };
+
+    tree_node* cur = bimap_details::first(end);
+    for (std::size_t i = 0; i < size; ++i) {
+      const batch_entry& entry = *order[i].entry;
+      if (!entry.node) {
+        continue;
+      }
+      while (cur != entry.next[side]) {
+        tree_node* existing = cur;
+        cur = bimap_details::step(cur, 1);
+        append(existing);
+      }
+      append(entry.node->template as<Tag>());
+    }
+    while (cur != end) {
+      tree_node* existing = cur;
+      cur = bimap_details::step(cur, 1);
+      append(existing);
+    }
+    if (tail) {
+      tail->children[0] = nullptr;
+    }
+    build_tree<Tag>(list, total);
+  }
+
+  // Makes the `Tag` tree a balanced one of the `size` nodes of `list`, chained in order through `children[0]`.
+  template <typename Tag>
+  void build_tree(tree_node* list, std::size_t size) noexcept {
+    tree_node* end = end_node<Tag>();
+    bimap_details::thread_list(end, list);
+    end->children[0] = bimap_details::build_balanced(list, size);
+    if (end->children[0]) {
+      end->children[0]->parent = end;
+    }
+  }
+
+  enum class set_operation {
+    unite,
+    intersect,
+    subtract,
+  };
+
+  // Walks the left orders of `*this` and `rhs` in lockstep and clones the pairs `op` keeps into the result,
+  // which thus comes out in left order. Then walks the right orders in lockstep and links the clones of the
+  // pairs met there. Only a union can have right keys clash, between a pair of `*this` and one of `rhs`,
+  // which is then dropped.
+  bimap merge(const bimap& rhs, set_operation op) const {
+    bimap result(left_compare.compare, right_compare.compare);
+    std::size_t bound = op == set_operation::unite ? count + rhs.count : count;
+    if (bound == 0) {
+      return result;
+    }
+    if constexpr (compact) {
+      result.reserve_nodes(bound);
+    }
+    auto left_order = std::make_unique_for_overwrite<node_t*[]>(bound);
+    bimap_details::index_table<node_t> clones(bound);
+    std::size_t size = 0;
+    std::size_t kept = 0;
+    tree_node* right_list = nullptr;
+    try {
+      tree_node* lhs_end = end_node<left_tag>();
+      tree_node* rhs_end = rhs.end_node<left_tag>();
+      tree_node* l = bimap_details::first(lhs_end);
+      tree_node* r = bimap_details::first(rhs_end);
+      while (l != lhs_end || (op == set_operation::unite && r != rhs_end)) {
+        const node_t* source;
+        bool keep;
+        if (r == rhs_end || (l != lhs_end && less<left_tag>(key_of<left_tag>(l), key_of<left_tag>(r)))) {
+          source = to_node<left_tag>(l);
+          keep = op != set_operation::intersect;
+          l = bimap_details::step(l, 1);
+        } else if (l == lhs_end || less<left_tag>(key_of<left_tag>(r), key_of<left_tag>(l))) {
+          source = to_node<left_tag>(r);
+          keep = op == set_operation::unite;
+          r = bimap_details::step(r, 1);
+        } else {
+          source = to_node<left_tag>(l);
+          bool same = equivalent<right_tag>(
+              source->template key<right_tag>(),
+              to_node<left_tag>(r)->template key<right_tag>()
+          );
+          keep = op == set_operation::unite || same == (op == set_operation::intersect);
+          l = bimap_details::step(l, 1);
+          r = bimap_details::step(r, 1);
+        }
+        if (keep) {
+          left_order[size] = result.create_node(
+              source->template key<left_tag>(),
+              source->template key<right_tag>(),
+              source->template projection<left_tag>(),
+              source->template projection<right_tag>()
+          );
+          clones.insert(source, size);
+          ++size;
+        }
+      }
+
+      tree_node* tail = nullptr;
+      auto take = [&](tree_node* links) {
+        std::size_t index = clones.find(to_node<right_tag>(links));
+        if (index != clones.none) {
+          tree_node* clone = left_order[index]->template as<right_tag>();
+          if (tail) {
+            tail->children[0] = clone;
+          } else {
+            right_list = clone;
+          }
+          tail = clone;
+          ++kept;
+        }
+      };
+      lhs_end = end_node<right_tag>();
+      rhs_end = rhs.end_node<right_tag>();
+      l = bimap_details::first(lhs_end);
+      r = op == set_operation::unite ? bimap_details::first(rhs_end) : rhs_end;
+      while (l != lhs_end || r != rhs_end) {
+        if (l == lhs_end || (r != rhs_end && less<right_tag>(key_of<right_tag>(r), key_of<right_tag>(l)))) {
+          take(r);
+          r = bimap_details::step(r, 1);
+          continue;
+        }
+        // Of two clashing pairs, the one of `*this` is kept.
+        if (r != rhs_end && !less<right_tag>(key_of<right_tag>(l), key_of<right_tag>(r))) {
+          std::size_t index = clones.find(to_node<right_tag>(r));
+          if (index != clones.none) {
+            result.destroy_node(left_order[index]);
+            left_order[index] = nullptr;
+          }
+          r = bimap_details::step(r, 1);
+        }
+        take(l);
+        l = bimap_details::step(l, 1);
+      }
+      if (tail) {
+        tail->children[0] = nullptr;
+      }
+    } catch (...) {
+      for (std::size_t i = 0; i < size; ++i) {
+        if (left_order[i]) {
+          result.destroy_node(left_order[i]);
+        }
+      }
+      throw;
+    }
+
+    for (std::size_t i = 0; i < size; ++i) {
+      if (node_t* node = left_order[i]) {
+        result.note_inserted(node);
+      }
+    }
+    tree_node* left_list = nullptr;
+    for (std::size_t i = size; i-- > 0;) {
+      if (node_t* node = left_order[i]) {
+        tree_node* links = node->template as<left_tag>();
+        links->children[0] = left_list;
+        left_list = links;
+      }
+    }
+    result.template build_tree<left_tag>(left_list, kept);
+    result.template build_tree<right_tag>(right_list, kept);
+    result.count = kept;
+    return result;
+  }
+
+  // Links `node`, whose keys have been constructed in place, if neither of them is taken, and destroys it otherwise.
+  left_iterator insert_node(node_t* node) {
+    try {
+      fill_projection<left_tag>(node);
+      fill_projection<right_tag>(node);
+      position left_pos = find_position(node_probe<left_tag>(node->template as<left_tag>()));
+      if (!left_pos.found) {
+        position right_pos = find_position(node_probe<right_tag>(node->template as<right_tag>()));
+        if (!right_pos.found) {
+          link_node(node, left_pos, right_pos);
+          return left_iterator(node->template as<left_tag>());
+        }
+      }
+    } catch (...) {
+      destroy_node(node);
+      throw;
+    }
+    destroy_node(node);
+    return end_left();
+  }
+
+  template <typename Tag>
+  void fill_projection(node_t* node) const {
+    if constexpr (projected<Tag>) {
+      node->template projection<Tag>() = comparator<Tag>().project(node->template key<Tag>());
+    }
+  }
+
+  // Looks up `key` before anything is constructed, then builds the node with the opposite key made from `args`
+  // and looks that one up.
+  template <typename Tag, typename K, typename... Args>
+  basic_iterator<Tag> try_emplace(K&& key, Args&&... args) {
+    using other_tag = opposite_tag<Tag>;
+
+    probe<Tag> key_probe = make_probe<Tag>(key);
+    position pos = find_position(key_probe);
+    if (pos.found) {
+      return end<Tag>();
+    }
+    auto key_args = std::forward_as_tuple(std::forward<K>(key));
+    auto other_args = std::forward_as_tuple(std::forward<Args>(args)...);
+    if constexpr (compact) {
+      if (needs_room()) {
+        // Built outside the pool first, so that a pair rejected for its opposite key does not grow it.
+        node_t staged = [&] {
+          if constexpr (std::is_same_v<Tag, left_tag>) {
+            return node_t(std::piecewise_construct, std::move(key_args), std::move(other_args));
+          } else {
+            return node_t(std::piecewise_construct, std::move(other_args), std::move(key_args));
+          }
+        }();
+        if constexpr (projected<Tag>) {
+          staged.template projection<Tag>() = key_probe.projection;
+        }
+        fill_projection<other_tag>(&staged);
+        if (find_position(node_probe<other_tag>(staged.template as<other_tag>())).found) {
+          return end<Tag>();
+        }
+        make_room();
+        left_iterator it = insert_node(adopt_node(staged));
+        if constexpr (std::is_same_v<Tag, left_tag>) {
+          return it;
+        } else {
+          return it.flip();
+        }
+      }
+    }
+    node_t* node;
+    if constexpr (std::is_same_v<Tag, left_tag>) {
+      node = create_node(std::piecewise_construct, std::move(key_args), std::move(other_args));
+    } else {
+      node = create_node(std::piecewise_construct, std::move(other_args), std::move(key_args));
+    }
+    try {
+      if constexpr (projected<Tag>) {
+        node->template projection<Tag>() = key_probe.projection;
+      }
+      fill_projection<other_tag>(node);
+      position other_pos = find_position(node_probe<other_tag>(node->template as<other_tag>()));
+      if (!other_pos.found) {
+        if constexpr (std::is_same_v<Tag, left_tag>) {
+          link_node(node, pos, other_pos);
+        } else {
+          link_node(node, other_pos, pos);
+        }
+        return basic_iterator<Tag>(node->template as<Tag>());
+      }
+    } catch (...) {
+      destroy_node(node);
+      throw;
+    }
+    destroy_node(node);
+    return end<Tag>();
+  }
+
+  void erase_node(node_t* node) noexcept {
+    bimap_details::unlink(node->template as<left_tag>());
+    bimap_details::unlink(node->template as<right_tag>());
+    release_node(node);
+    --count;
+  }
+
+  template <typename Tag>
+  basic_iterator<Tag> erase_at(basic_iterator<Tag> it) noexcept {
+    basic_iterator<Tag> next = std::next(it);
+    erase_node(to_node<Tag>(it.node));
+    return next;
+  }
+
+  template <typename Tag>
+  bool erase_key(const key_t<Tag>& key) {
+    tree_node* found = find_node<Tag>(make_probe<Tag>(key));
+    if (!found) {
+      return false;
+    }
+    erase_node(to_node<Tag>(found));
+    return true;
+  }
+
+  // Cuts [first, last) out of the `Tag` tree with two splits and a join, then drops the partners from the opposite
+  // tree: one by one if few pairs are erased, or by rebuilding it from the survivors if most of them are.
+  // Nodes are freed together at the end. Erased nodes are marked by a self-loop in their `Tag` parent link.
+  template <typename Tag>
+  basic_iterator<Tag> erase_range(basic_iterator<Tag> first, basic_iterator<Tag> last) noexcept {
+    using other_tag = opposite_tag<Tag>;
+
+    if (first == last) {
+      return last;
+    }
+    if (first == begin<Tag>() && last == end<Tag>()) {
+      clear();
+      return end<Tag>();
+    }
+
+    tree_node* end = end_node<Tag>();
+    bimap_details::unthread_range(first.node, last.node);
+    end->children[0]->parent = nullptr;
+    auto [before, from_first] = bimap_details::split_before(first.node);
+    tree_node* middle = from_first;
+    tree_node* after = nullptr;
+    if (last.node != end) {
+      std::tie(middle, after) = bimap_details::split_before(last.node);
+    }
+    end->children[0] = bimap_details::join(before, after);
+    if (end->children[0]) {
+      end->children[0]->parent = end;
+    }
+
+    tree_node* erased = nullptr;
+    std::size_t erased_count = 0;
+    for (tree_node* cur = middle; cur;) {
+      if (cur->children[0]) {
+        cur = cur->children[0];
+      } else if (cur->children[1]) {
+        cur = cur->children[1];
+      } else {
+        tree_node* parent = cur->parent;
+        if (parent) {
+          parent->children[parent->children[1] == cur] = nullptr;
+        }
+        cur->parent = cur;
+        cur->children[0] = erased;
+        erased = cur;
+        ++erased_count;
+        cur = parent;
+      }
+    }
+
+    if (erased_count * 2 > count) {
+      rebuild_without_erased<other_tag>(count - erased_count);
+    } else {
+      for (tree_node* cur = erased; cur; cur = cur->children[0]) {
+        bimap_details::unlink(to_node<Tag>(cur)->template as<other_tag>());
+      }
+    }
+    while (erased) {
+      node_t* node = to_node<Tag>(erased);
+      erased = erased->children[0];
+      release_node(node);
+    }
+    count -= erased_count;
+    return last;
+  }
+
+  // Rebuilds the `Tag` tree as a balanced one from its `survivors` nodes not marked as erased by `erase_range`.
+  template <typename Tag>
+  void rebuild_without_erased(std::size_t survivors) noexcept {
+    using other_tag = opposite_tag<Tag>;
+
+    tree_node* end = end_node<Tag>();
+    tree_node* list = nullptr;
+    tree_node* tail = nullptr;
+    for (tree_node* cur = bimap_details::first(end); cur != end; cur = bimap_details::step(cur, 1)) {
+      tree_node* links = node_t::template from<Tag>(cur)->template as<other_tag>();
+      if (links->parent != links) {
+        if (tail) {
+          tail->children[0] = cur;
+        } else {
+          list = cur;
+        }
+        tail = cur;
+      }
+    }
+    if (tail) {
+      tail->children[0] = nullptr;
+    }
+    bimap_details::thread_list(end, list);
+    end->children[0] = bimap_details::build_balanced(list, survivors);
+    if (end->children[0]) {
+      end->children[0]->parent = end;
+    }
+  }
+
+  // One descent per side. If the default opposite key is already taken, its node is moved over to `key`:
+  // it keeps its place in the opposite tree and is relinked into the slot found by the first descent.
+  template <typename Tag>
+  const key_t<opposite_tag<Tag>>& at_or_default(const key_t<Tag>& key) {
+    using other_tag = opposite_tag<Tag>;
+
+    probe<Tag> key_probe = make_probe<Tag>(key);
+    position pos = find_position(key_probe);
+    if (pos.found) {
+      return to_node<Tag>(pos.found)->template key<other_tag>();
+    }
+    key_t<other_tag> default_key = key_t<other_tag>();
+    probe<other_tag> default_probe = make_probe<other_tag>(default_key);
+    position other_pos = find_position(default_probe);
+    if (needs_room() && (!other_pos.found || !replaces_in_place<Tag>)) {
+      make_room();
+      pos = find_position(key_probe);
+      other_pos = find_position(default_probe);
+    }
+    if (!other_pos.found) {
+      node_t* node = make_node<Tag>(key, std::move(default_key), key_probe.projection, default_probe.projection);
+      if constexpr (std::is_same_v<Tag, left_tag>) {
+        link_node(node, pos, other_pos);
+      } else {
+        link_node(node, other_pos, pos);
+      }
+      return node->template key<other_tag>();
+    }
+
+    node_t* node = to_node<other_tag>(other_pos.found);
+    node = replace_key<Tag>(node, pos, key, key_probe.projection, std::move(default_key));
+    return node->template key<other_tag>();
+  }
+
+  // Whether `replace_key` puts the new key into the node it is given rather than into a fresh one.
+  template <typename Tag>
+  static constexpr bool replaces_in_place = std::is_nothrow_move_constructible_v<key_t<Tag>> && !tracks_changes;
+
+  // Gives `node` a new key on the `Tag` side and moves it to `pos`, the result of a descent for that key.
+  // The opposite tree is left as is, and nothing is allocated if the key can be moved in without throwing.
+  // Otherwise a fresh node built from `key` and `other_key` takes over, so that a throw leaves `node` intact.
+  // A left key that has to be moved out of `node` is moved back if the new right key throws.
+  template <typename Tag, typename K, typename O>
+  node_t* replace_key(node_t* node, position pos, K&& key, const projection_t<Tag>& projection, O&& other_key) {
+    using other_tag = opposite_tag<Tag>;
+
+    tree_node* links = node->template as<Tag>();
+    bool in_place = pos.parent == links || pos.found == links;
+    if constexpr (replaces_in_place<Tag>) {
+      key_t<Tag> replacement(std::forward<K>(key));
+      if (!in_place) {
+        bimap_details::unlink(links);
+        bimap_details::relink(links, pos);
+      }
+      std::destroy_at(std::addressof(node->template key<Tag>()));
+      std::construct_at(std::addressof(node->template key<Tag>()), std::move(replacement));
+      if constexpr (projected<Tag>) {
+        node->template projection<Tag>() = projection;
+      }
+      return node;
+    } else {
+      node_t* fresh;
+      if constexpr (std::is_same_v<Tag, right_tag> && std::is_rvalue_reference_v<O&&>
+                    && std::is_nothrow_move_constructible_v<Left>) {
+        fresh = create_node(
+            bimap_details::reclaim_left,
+            other_key,
+            std::forward<K>(key),
+            node->template projection<other_tag>(),
+            projection
+        );
+      } else {
+        fresh = make_node<Tag>(
+            std::forward<K>(key),
+            std::forward<O>(other_key),
+            projection,
+            node->template projection<other_tag>()
+        );
+      }
+      bimap_details::transplant(node->template as<other_tag>(), fresh->template as<other_tag>());
+      if (in_place) {
+        bimap_details::transplant(links, fresh->template as<Tag>());
+      } else {
+        bimap_details::unlink(links);
+        bimap_details::relink(fresh->template as<Tag>(), pos);
+      }
+      release_node(node);
+      note_inserted(fresh);
+      return fresh;
+    }
+  }
+
+  template <typename Tag>
+  basic_iterator<Tag> replace(basic_iterator<opposite_tag<Tag>> it, key_t<Tag>&& key) {
+    using other_tag = opposite_tag<Tag>;
+
+    node_t* node = to_node<other_tag>(it.node);
+    probe<Tag> key_probe = make_probe<Tag>(key);
+    position pos = find_position(key_probe);
+    if (pos.found && pos.found != node->template as<Tag>()) {
+      return end<Tag>();
+    }
+    if constexpr (compact && !replaces_in_place<Tag>) {
+      if (needs_room()) {
+        std::size_t index = pool.index_of(node);
+        make_room();
+        node = pool.slot(index);
+        pos = find_position(key_probe);
+      }
+    }
+    using other_source = std::conditional_t<
+        std::is_copy_constructible_v<key_t<other_tag>>,
+        const key_t<other_tag>&,
+        key_t<other_tag>&&>;
+    node = replace_key<Tag>(
+        node,
+        pos,
+        std::move(key),
+        key_probe.projection,
+        static_cast<other_source>(node->template key<other_tag>())
+    );
+    return basic_iterator<Tag>(node->template as<Tag>());
+  }
+
+  // Clones the left tree shape node by node and inserts every clone into the right tree.
+  // Storage for the clones comes from `allocate`.
+  template <typename Allocate>
+  void copy_from(const bimap& other, Allocate allocate) {
+    tree_node* src = other.root<left_tag>();
+    tree_node* dst_parent = end_node<left_tag>();
+    int dir = 0;
+    while (src) {
+      node_t* src_node = to_node<left_tag>(src);
+      position right_pos = find_position(node_probe<right_tag>(src_node->template as<right_tag>()));
+      node_t* clone = construct_node(
+          allocate(),
+          src_node->template key<left_tag>(),
+          src_node->template key<right_tag>(),
+          src_node->template projection<left_tag>(),
+          src_node->template projection<right_tag>()
+      );
+      link_node(clone, {dst_parent, dir, nullptr, 0}, right_pos);
+
+      tree_node* dst = clone->template as<left_tag>();
+      if (src->children[0] || src->children[1]) {
+        dir = src->children[0] ? 0 : 1;
+        src = src->children[dir];
+        dst_parent = dst;
+        continue;
+      }
+      while (src != other.root<left_tag>()) {
+        tree_node* src_parent = src->parent;
+        dst = dst->parent;
+        if (src_parent->children[0] == src && src_parent->children[1]) {
+          src = src_parent->children[1];
+          dst_parent = dst;
+          dir = 1;
+          break;
+        }
+        src = src_parent;
+      }
+      if (src == other.root<left_tag>()) {
+        break;
+      }
+    }
+  }
+
+  // Walks the left tree in order, rotating every left child up before handing the node over to `dispose`,
+  // so that the teardown is a single linear pass with no recursion and no parent links read.
+  template <typename Dispose>
+  void tear_down(Dispose dispose) noexcept {
+    tree_node* cur = root<left_tag>();
+    while (cur) {
+      if (tree_node* left = cur->children[0]) {
+        cur->children[0] = left->children[1];
+        left->children[1] = cur;
+        cur = left;
+      } else {
+        tree_node* next = cur->children[1];
+        dispose(to_node<left_tag>(cur));
+        cur = next;
+      }
+    }
+    forget_nodes();
+  }
 
-  bimap(const bimap& other);
-  bimap(bimap&& other) noexcept;
+  // Empties both trees without touching the nodes.
+  void forget_nodes() noexcept {
+    bimap_details::reset(end_node<left_tag>());
+    bimap_details::reset(end_node<right_tag>());
+    count = 0;
+  }
 
-  bimap& operator=(const bimap& other);
-  bimap& operator=(bimap&& other) noexcept;
+  // Copies `other` into the nodes of `*this`. Copying the comparators and allocating the nodes `*this` is short of
+  // are the only steps that may throw, so they come first and a throw leaves `*this` intact.
+  void refill_from(const bimap& other) {
+    CompareLeft compare_left(other.left_compare.compare);
+    CompareRight compare_right(other.right_compare.compare);
+    std::size_t kept = 0;
+    if constexpr (compact) {
+      reserve_nodes(other.count);
+      clear();
+    } else {
+      // Once torn down, the heap nodes of `*this` and all inline slots are free again.
+      kept = pool.size();
+      std::size_t reused = count - inline_nodes.size() + inline_capacity;
+      if (other.count > reused) {
+        try {
+          pool.reserve(kept + other.count - reused);
+        } catch (...) {
+          pool.release(kept);
+          throw;
+        }
+      }
+      tear_down([this](node_t* node) noexcept {
+        std::destroy_at(node);
+        recycle_node(node);
+      });
+    }
+    using std::swap;
+    swap(left_compare.compare, compare_left);
+    swap(right_compare.compare, compare_right);
+    copy_from(other, [this]() noexcept { return allocate_node(); });
+    if constexpr (!compact) {
+      pool.release(kept);
+    }
+  }
 
-  ~bimap();
+  // Whether the next node allocation moves the existing nodes, which makes positions found before it stale.
+  // Operations that may turn out not to allocate descend first and make room only once they know they will,
+  // then descend again, so that a lookup hit or a rejected duplicate keeps iterators valid.
+  bool needs_room() const noexcept {
+    if constexpr (compact) {
+      return count == pool.capacity();
+    } else {
+      return false;
+    }
+  }
 
-  friend void swap(bimap& lhs, bimap& rhs);
+  // Makes sure that the next node allocation does not move the existing nodes.
+  void make_room() {
+    if constexpr (compact) {
+      if (count == pool.capacity()) {
+        reserve_nodes(std::max(count + 1, pool.capacity() * 2));
+      }
+    }
+  }
 
-  left_iterator insert(const left_t& left, const right_t& right);
-  left_iterator insert(const left_t& left, right_t&& right);
-  left_iterator insert(left_t&& left, const right_t& right);
-  left_iterator insert(left_t&& left, right_t&& right);
+  // Makes room for `capacity` nodes in total.
+  void reserve_nodes(std::size_t capacity) {
+    if constexpr (compact) {
+      if (capacity <= pool.capacity()) {
+        return;
+      }
+      if (capacity > pool_t::max_capacity) {
+        if (count == pool_t::max_capacity) {
+          throw std::length_error("bimap: compact node pool is full");
+        }
+        capacity = pool_t::max_capacity;
+      }
+      grow_pool(capacity);
+    }
+  }
 
-  left_iterator erase_left(left_iterator it);
-  right_iterator erase_right(right_iterator it);
+  // Moves every node to the same index of a new pool. The layout does not change, so the relative links are copied
+  // as they are. Keys are copied unless they can be moved without throwing, so a throw leaves the bimap intact.
+  void grow_pool(std::size_t capacity)
+    requires compact
+  {
+    pool_t fresh(capacity);
+    tree_node* end = end_node<left_tag>();
+    tree_node* cur = bimap_details::first(end);
+    try {
+      for (; cur != end; cur = bimap_details::step(cur, 1)) {
+        node_t* from = to_node<left_tag>(cur);
+        node_t* to = std::construct_at(
+            fresh.slot(pool.index_of(from)),
+            std::move_if_noexcept(from->template key<left_tag>()),
+            std::move_if_noexcept(from->template key<right_tag>()),
+            from->template projection<left_tag>(),
+            from->template projection<right_tag>()
+        );
+        to->template as<left_tag>()->relocate_from(*from->template as<left_tag>());
+        to->template as<right_tag>()->relocate_from(*from->template as<right_tag>());
+      }
+    } catch (...) {
+      for (tree_node* done = bimap_details::first(end); done != cur; done = bimap_details::step(done, 1)) {
+        std::destroy_at(fresh.slot(pool.index_of(to_node<left_tag>(done))));
+      }
+      throw;
+    }
 
-  bool erase_left(const left_t& left);
-  bool erase_right(const right_t& right);
+    if (pool.sentinel()) {
+      fresh.sentinel()->template as<left_tag>()->relocate_from(*end_node<left_tag>());
+      fresh.sentinel()->template as<right_tag>()->relocate_from(*end_node<right_tag>());
+      fresh.adopt_free_slots(pool);
+    }
+    std::size_t size = count;
+    tear_down([](node_t* node) noexcept { std::destroy_at(node); });
+    count = size;
+    swap(pool, fresh);
+  }
 
-  left_iterator erase_left(left_iterator first, left_iterator last);
-  right_iterator erase_right(right_iterator first, right_iterator last);
+  // Packs the nodes into a pool of exactly `count` slots, in left order. The layout changes, so every link
+  // is redirected to the new slot of its target, which is looked up by the old index.
+  void shrink_pool()
+    requires compact
+  {
+    if (count == pool.capacity()) {
+      return;
+    }
+    if (count == 0) {
+      pool_t empty;
+      swap(pool, empty);
+      return;
+    }
 
-  left_iterator find_left(const left_t& left) const;
-  right_iterator find_right(const right_t& right) const;
+    pool_t fresh(count);
+    auto moved_to = std::make_unique_for_overwrite<std::uint32_t[]>(pool.capacity());
+    tree_node* end = end_node<left_tag>();
+    std::uint32_t moved = 0;
+    try {
+      for (tree_node* cur = bimap_details::first(end); cur != end; cur = bimap_details::step(cur, 1)) {
+        node_t* from = to_node<left_tag>(cur);
+        std::construct_at(
+            fresh.slot(moved),
+            std::move_if_noexcept(from->template key<left_tag>()),
+            std::move_if_noexcept(from->template key<right_tag>()),
+            from->template projection<left_tag>(),
+            from->template projection<right_tag>()
+        );
+        moved_to[pool.index_of(from)] = moved++;
+      }
+    } catch (...) {
+      while (moved > 0) {
+        std::destroy_at(fresh.slot(--moved));
+      }
+      throw;
+    }
 
-  const right_t& at_left(const left_t& key) const;
-  const left_t& at_right(const right_t& key) const;
+    for (tree_node* cur = bimap_details::first(end); cur != end; cur = bimap_details::step(cur, 1)) {
+      node_t* from = to_node<left_tag>(cur);
+      node_t* to = fresh.slot(moved_to[pool.index_of(from)]);
+      move_links<left_tag>(from, to, fresh, moved_to.get());
+      move_links<right_tag>(from, to, fresh, moved_to.get());
+    }
+    fresh.sentinel()->template as<left_tag>()->children[0] =
+        moved_link<left_tag>(root<left_tag>(), fresh, moved_to.get());
+    fresh.sentinel()->template as<right_tag>()->children[0] =
+        moved_link<right_tag>(root<right_tag>(), fresh, moved_to.get());
+    fresh.take_slots(count);
 
-  const right_t& at_left_or_default(const left_t& key);
-  const left_t& at_right_or_default(const right_t& key);
+    std::size_t size = count;
+    tear_down([](node_t* node) noexcept { std::destroy_at(node); });
+    count = size;
+    swap(pool, fresh);
+  }
 
-  left_iterator lower_bound_left(const left_t& left) const;
-  left_iterator upper_bound_left(const left_t& left) const;
+  template <typename Tag>
+  void move_links(node_t* from, node_t* to, const pool_t& fresh, const std::uint32_t* moved_to) const noexcept {
+    tree_node* links = from->template as<Tag>();
+    tree_node* moved = to->template as<Tag>();
+    moved->parent = moved_link<Tag>(links->parent, fresh, moved_to);
+    moved->children[0] = moved_link<Tag>(links->children[0], fresh, moved_to);
+    moved->children[1] = moved_link<Tag>(links->children[1], fresh, moved_to);
+  }
 
-  right_iterator lower_bound_right(const right_t& right) const;
-  right_iterator upper_bound_right(const right_t& right) const;
+  template <typename Tag>
+  tree_node* moved_link(tree_node* link, const pool_t& fresh, const std::uint32_t* moved_to) const noexcept {
+    if (!link) {
+      return nullptr;
+    }
+    if (link == end_node<Tag>()) {
+      return fresh.sentinel()->template as<Tag>();
+    }
+    return fresh.slot(moved_to[pool.index_of(to_node<Tag>(link))])->template as<Tag>();
+  }
 
-  left_iterator begin_left() const;
-  left_iterator end_left() const;
+  template <typename Tag>
+  static void swap_roots(bimap& lhs, bimap& rhs) noexcept {
+    bimap_details::swap_trees(lhs.end_node<Tag>(), rhs.end_node<Tag>());
+  }
 
-  right_iterator begin_right() const;
-  right_iterator end_right() const;
+  void steal(bimap& other) noexcept {
+    swap(pool, other.pool);
+    if constexpr (!compact) {
+      swap_roots<left_tag>(*this, other);
+      swap_roots<right_tag>(*this, other);
+    }
+    if constexpr (inline_capacity > 0) {
+      swap_inline_nodes(*this, other);
+    }
+    count = std::exchange(other.count, 0);
+    swap(history, other.history);
+    other.restart_history(*this);
+  }
 
-  bool empty() const;
+  // Moves the keys of `node` into `storage` and puts the new node at the place of `node` in both trees.
+  static void relocate_node(node_t* node, node_t* storage) noexcept
+    requires(inline_capacity > 0)
+  {
+    node_t* moved = std::construct_at(
+        storage,
+        std::move(node->template key<left_tag>()),
+        std::move(node->template key<right_tag>()),
+        node->template projection<left_tag>(),
+        node->template projection<right_tag>()
+    );
+    bimap_details::transplant(node->template as<left_tag>(), moved->template as<left_tag>());
+    bimap_details::transplant(node->template as<right_tag>(), moved->template as<right_tag>());
+    std::destroy_at(node);
+  }
 
-  std::size_t size() const;
+  // After the trees of `lhs` and `rhs` have been exchanged, the nodes in the inline slots of each of them
+  // belong to the other one, so they are moved over. A slot taken in both is exchanged through a local node.
+  static void swap_inline_nodes(bimap& lhs, bimap& rhs) noexcept
+    requires(inline_capacity > 0)
+  {
+    if (&lhs == &rhs) {
+      return;
+    }
+    std::uint64_t lhs_used = lhs.inline_nodes.occupied();
+    std::uint64_t rhs_used = rhs.inline_nodes.occupied();
+    for (std::size_t i = 0; i < inline_capacity; ++i) {
+      bool in_lhs = lhs_used >> i & 1;
+      bool in_rhs = rhs_used >> i & 1;
+      if (in_lhs && in_rhs) {
+        alignas(node_t) std::byte buffer[sizeof(node_t)];
+        node_t* temporary = reinterpret_cast<node_t*>(buffer);
+        relocate_node(lhs.inline_nodes.slot(i), temporary);
+        relocate_node(rhs.inline_nodes.slot(i), lhs.inline_nodes.storage(i));
+        relocate_node(std::launder(temporary), rhs.inline_nodes.storage(i));
+      } else if (in_lhs) {
+        relocate_node(lhs.inline_nodes.slot(i), rhs.inline_nodes.storage(i));
+      } else if (in_rhs) {
+        relocate_node(rhs.inline_nodes.slot(i), lhs.inline_nodes.storage(i));
+      }
+    }
+    lhs.inline_nodes.set_occupied(rhs_used);
+    rhs.inline_nodes.set_occupied(lhs_used);
+  }
 
-  friend bool operator==(const bimap& lhs, const bimap& rhs);
-  friend bool operator!=(const bimap& lhs, const bimap& rhs);
+private:
+  // Comparators go first: if both are the same empty type, the second one can only be placed
+  // at a non-zero offset, which is inside the sentinel rather than past the end of the object.
+  [[no_unique_address]] bimap_details::comparator_holder<CompareLeft, left_tag> left_compare;
+  [[no_unique_address]] bimap_details::comparator_holder<CompareRight, right_tag> right_compare;
+  node_base sentinel;
+  [[no_unique_address]] pool_t pool;
+  std::size_t count = 0;
+  [[no_unique_address]] bimap_details::inline_slots<node_t, inline_capacity> inline_nodes;
+  [[no_unique_address]] history_t history;
 };
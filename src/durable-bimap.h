@@ -0,0 +1,533 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// How a key is stored in the log and in snapshots of a `durable_bimap`. `encode` appends the bytes of a value,
+// `decode` reads one from the front of `in`, advancing it, or returns nothing if `in` is too short.
+// Trivially copyable types and strings of them are covered; other key types need a specialization.
+template <typename T>
+struct durable_codec;
+
+template <typename T>
+  requires std::is_trivially_copyable_v<T>
+struct durable_codec<T> {
+  static void encode(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  static std::optional<T> decode(std::string_view& in) {
+    if (in.size() < sizeof(T)) {
+      return std::nullopt;
+    }
+    alignas(T) std::byte bytes[sizeof(T)];
+    std::memcpy(bytes, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return std::bit_cast<T>(bytes);
+  }
+};
+
+template <typename Char, typename Traits, typename Allocator>
+  requires std::is_trivially_copyable_v<Char>
+struct durable_codec<std::basic_string<Char, Traits, Allocator>> {
+  using string = std::basic_string<Char, Traits, Allocator>;
+
+  static void encode(std::string& out, const string& value) {
+    durable_codec<std::uint64_t>::encode(out, value.size());
+    out.append(reinterpret_cast<const char*>(value.data()), value.size() * sizeof(Char));
+  }
+
+  static std::optional<string> decode(std::string_view& in) {
+    std::optional<std::uint64_t> size = durable_codec<std::uint64_t>::decode(in);
+    if (!size || (in.size() / sizeof(Char)) < *size) {
+      return std::nullopt;
+    }
+    string value(static_cast<std::size_t>(*size), Char());
+    std::memcpy(value.data(), in.data(), value.size() * sizeof(Char));
+    in.remove_prefix(value.size() * sizeof(Char));
+    return value;
+  }
+};
+
+namespace bimap_details {
+
+// FNV-1a, enough to tell a torn or garbled record from a whole one.
+inline std::uint32_t checksum(std::string_view bytes, std::uint32_t hash = 2166136261u) noexcept {
+  for (char c : bytes) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+[[noreturn]] inline void throw_io_error(const char* what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+// An open file with its contents pushed all the way to the disk by `sync`.
+class durable_file {
+public:
+  durable_file(const std::filesystem::path& path, const char* mode)
+      : file(std::fopen(path.string().c_str(), mode)) {
+    if (!file) {
+      throw_io_error("durable_bimap: cannot open file");
+    }
+  }
+
+  durable_file(const durable_file&) = delete;
+  durable_file& operator=(const durable_file&) = delete;
+
+  ~durable_file() {
+    std::fclose(file);
+  }
+
+  void write(std::string_view bytes) {
+    if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+      throw_io_error("durable_bimap: cannot write file");
+    }
+  }
+
+  void sync() {
+    if (std::fflush(file) != 0) {
+      throw_io_error("durable_bimap: cannot write file");
+    }
+#if defined(_WIN32)
+    int result = _commit(_fileno(file));
+#else
+    int result = ::fsync(::fileno(file));
+#endif
+    if (result != 0) {
+      throw_io_error("durable_bimap: cannot sync file");
+    }
+  }
+
+private:
+  std::FILE* file;
+};
+
+// Makes a rename within `directory` durable. Windows commits renames with the file system metadata.
+inline void sync_directory([[maybe_unused]] const std::filesystem::path& directory) {
+#if !defined(_WIN32)
+  int fd = ::open(directory.empty() ? "." : directory.string().c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw_io_error("durable_bimap: cannot open directory");
+  }
+  int result = ::fsync(fd);
+  ::close(fd);
+  if (result != 0) {
+    throw_io_error("durable_bimap: cannot sync directory");
+  }
+#endif
+}
+
+inline std::string read_file(const std::filesystem::path& path) {
+  std::string contents;
+  std::FILE* file = std::fopen(path.string().c_str(), "rb");
+  if (!file) {
+    return contents;
+  }
+  char buffer[1 << 16];
+  for (std::size_t read; (read = std::fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+    contents.append(buffer, read);
+  }
+  bool failed = std::ferror(file);
+  std::fclose(file);
+  if (failed) {
+    throw_io_error("durable_bimap: cannot read file");
+  }
+  return contents;
+}
+
+} // namespace bimap_details
+
+// A bimap whose changes survive a crash. Every change is appended to a log file as a record with a checksum.
+// Records are buffered and written out with a single `fsync` once `sync_every` of them have piled up or `sync`
+// is called, so a crash loses at most the changes since the last sync, and the cost of an `fsync` is shared
+// by the whole group. Once `checkpoint_every` records have been logged, the pairs are written to a snapshot file,
+// which replaces the old one by an atomic rename, and the log starts over. The constructor loads the snapshot
+// and replays the log, up to the first torn record. A file at the log's path that is not a log, a log newer than
+// the snapshot and a record that does not apply are not crash damage, so the constructor throws on them.
+//
+// The sync that a full group triggers runs inside the change that filled it, after the change has been made.
+// If it throws, the change stays in the bimap: only writing the group out, or the checkpoint due after it, failed,
+// and `unsynced()` tells whether the records are still waiting.
+//
+// Both files carry a generation number, bumped by every checkpoint, so that a log left over from a crash between
+// writing a snapshot and starting the log anew is not replayed on top of a snapshot that already includes it.
+template <
+    typename Left,
+    typename Right,
+    typename CompareLeft = std::less<Left>,
+    typename CompareRight = std::less<Right>,
+    typename Policy = bimap_policy::standard>
+class durable_bimap {
+public:
+  using bimap_t = bimap<Left, Right, CompareLeft, CompareRight, Policy>;
+  using left_iterator = typename bimap_t::left_iterator;
+  using right_iterator = typename bimap_t::right_iterator;
+
+  struct options {
+    std::size_t sync_every = 1024;
+    std::size_t checkpoint_every = std::size_t(1) << 20;
+  };
+
+  // Recovers the pairs stored at `path`, or starts empty if there is nothing there. The log is kept at `path`
+  // itself and the snapshot next to it, with a `.snapshot` suffix.
+  explicit durable_bimap(std::filesystem::path path, options opts = {})
+      : log_path(std::move(path))
+      , snapshot_path(std::filesystem::path(log_path) += ".snapshot")
+      , opts(opts) {
+    recover();
+  }
+
+  durable_bimap(const durable_bimap&) = delete;
+  durable_bimap& operator=(const durable_bimap&) = delete;
+
+  // Syncs the pending changes; errors are swallowed, call `sync` first to see them.
+  ~durable_bimap() {
+    try {
+      sync();
+    } catch (...) {
+    }
+  }
+
+  // The pairs, for lookups and iteration. Changes go through `durable_bimap` only.
+  const bimap_t& view() const noexcept {
+    return pairs;
+  }
+
+  left_iterator insert(const Left& left, const Right& right) {
+    pending_record record(*this, op::insert, left, right);
+    left_iterator it = pairs.insert(left, right);
+    record.done(it != pairs.end_left());
+    return it;
+  }
+
+  bool erase_left(const Left& left) {
+    pending_record record(*this, op::erase_left, left);
+    bool erased = pairs.erase_left(left);
+    record.done(erased);
+    return erased;
+  }
+
+  bool erase_right(const Right& right) {
+    pending_record record(*this, op::erase_right, right);
+    bool erased = pairs.erase_right(right);
+    record.done(erased);
+    return erased;
+  }
+
+  left_iterator replace_left(right_iterator it, Left new_left) {
+    pending_record record(*this, op::replace_left, *it, new_left);
+    left_iterator replaced = pairs.replace_left(it, std::move(new_left));
+    record.done(replaced != pairs.end_left());
+    return replaced;
+  }
+
+  right_iterator replace_right(left_iterator it, Right new_right) {
+    pending_record record(*this, op::replace_right, *it, new_right);
+    right_iterator replaced = pairs.replace_right(it, std::move(new_right));
+    record.done(replaced != pairs.end_right());
+    return replaced;
+  }
+
+  void clear() {
+    pending_record record(*this, op::clear);
+    pairs.clear();
+    record.done(true);
+  }
+
+  // Writes the buffered records out and waits until they reach the disk, then checkpoints if it is time.
+  void sync() {
+    if (!pending.empty()) {
+      log->write(pending);
+      log->sync();
+      pending.clear();
+      pending_records = 0;
+    }
+    if (logged_records >= opts.checkpoint_every) {
+      checkpoint();
+    }
+  }
+
+  // Writes all pairs, synced or not, to a new snapshot and starts an empty log.
+  void checkpoint() {
+    std::uint64_t next_generation = generation + 1;
+    std::filesystem::path temporary = std::filesystem::path(snapshot_path) += ".tmp";
+    {
+      bimap_details::durable_file snapshot(temporary, "wb");
+      std::string chunk(snapshot_magic, sizeof(snapshot_magic));
+      durable_codec<std::uint64_t>::encode(chunk, next_generation);
+      durable_codec<std::uint64_t>::encode(chunk, pairs.size());
+      std::uint32_t hash = bimap_details::checksum(chunk);
+      for (auto it = pairs.begin_left(); it != pairs.end_left(); ++it) {
+        std::size_t from = chunk.size();
+        durable_codec<Left>::encode(chunk, *it);
+        durable_codec<Right>::encode(chunk, *it.flip());
+        hash = bimap_details::checksum(std::string_view(chunk).substr(from), hash);
+        if (chunk.size() >= chunk_size) {
+          snapshot.write(chunk);
+          chunk.clear();
+        }
+      }
+      durable_codec<std::uint32_t>::encode(chunk, hash);
+      snapshot.write(chunk);
+      snapshot.sync();
+    }
+    std::filesystem::rename(temporary, snapshot_path);
+    bimap_details::sync_directory(snapshot_path.parent_path());
+    // The snapshot has the unsynced changes too, so their records must not go to the new log.
+    pending.clear();
+    pending_records = 0;
+    generation = next_generation;
+    start_log();
+  }
+
+  // Records buffered since the last sync, which a crash would lose.
+  std::size_t unsynced() const noexcept {
+    return pending_records;
+  }
+
+private:
+  enum class op : unsigned char {
+    insert,
+    erase_left,
+    erase_right,
+    replace_left,
+    replace_right,
+    clear,
+  };
+
+  static constexpr char log_magic[8] = {'B', 'I', 'M', 'A', 'P', 'L', 'O', 'G'};
+  static constexpr char snapshot_magic[8] = {'B', 'I', 'M', 'A', 'P', 'S', 'N', 'P'};
+  static constexpr std::size_t header_size = sizeof(log_magic) + sizeof(std::uint64_t);
+  static constexpr std::size_t chunk_size = std::size_t(1) << 16;
+
+  // A record is its payload size and checksum followed by the payload: the operation and its keys.
+  // It is encoded at the end of the pending records before the change is made, so that a throw while encoding
+  // changes nothing, and dropped again unless `done` reports that the change took place.
+  class pending_record {
+  public:
+    template <typename... Keys>
+    pending_record(durable_bimap& owner, op operation, const Keys&... keys)
+        : owner(owner)
+        , mark(owner.pending.size()) {
+      std::string& out = owner.pending;
+      try {
+        out.append(2 * sizeof(std::uint32_t), '\0');
+        out += static_cast<char>(operation);
+        (durable_codec<Keys>::encode(out, keys), ...);
+      } catch (...) {
+        out.resize(mark);
+        throw;
+      }
+      std::string_view payload = std::string_view(out).substr(mark + 2 * sizeof(std::uint32_t));
+      auto size = static_cast<std::uint32_t>(payload.size());
+      std::uint32_t hash = bimap_details::checksum(payload);
+      std::memcpy(out.data() + mark, &size, sizeof(size));
+      std::memcpy(out.data() + mark + sizeof(size), &hash, sizeof(hash));
+    }
+
+    pending_record(const pending_record&) = delete;
+    pending_record& operator=(const pending_record&) = delete;
+
+    ~pending_record() {
+      if (!kept) {
+        owner.pending.resize(mark);
+      }
+    }
+
+    void done(bool changed) {
+      if (changed) {
+        kept = true;
+        ++owner.pending_records;
+        ++owner.logged_records;
+        if (owner.pending_records >= owner.opts.sync_every) {
+          owner.sync();
+        }
+      }
+    }
+
+  private:
+    durable_bimap& owner;
+    std::size_t mark;
+    bool kept = false;
+  };
+
+  void start_log() {
+    log.reset();
+    log.emplace(log_path, "wb");
+    std::string header(log_magic, sizeof(log_magic));
+    durable_codec<std::uint64_t>::encode(header, generation);
+    log->write(header);
+    log->sync();
+    logged_records = 0;
+  }
+
+  void recover() {
+    std::string snapshot = bimap_details::read_file(snapshot_path);
+    if (!snapshot.empty()) {
+      load_snapshot(snapshot);
+    }
+    std::string contents = bimap_details::read_file(log_path);
+    std::string_view in = contents;
+    std::string_view magic(log_magic, sizeof(log_magic));
+    if (in.substr(0, magic.size()) != magic.substr(0, std::min(in.size(), magic.size()))) {
+      throw std::runtime_error("durable_bimap: log is damaged");
+    }
+    // A missing or empty log, or one torn while its header was written, holds no records.
+    if (in.size() < header_size) {
+      start_log();
+      return;
+    }
+    in.remove_prefix(magic.size());
+    std::uint64_t log_generation = *durable_codec<std::uint64_t>::decode(in);
+    if (log_generation > generation) {
+      throw std::runtime_error("durable_bimap: log is newer than the snapshot");
+    }
+    // An older log is left over from a crash right after a checkpoint, and the snapshot already includes it.
+    if (log_generation < generation) {
+      start_log();
+      return;
+    }
+    std::size_t replayed = 0;
+    while (replay_record(in)) {
+      ++replayed;
+    }
+    // Cut off a torn tail, so that new records follow the last whole one.
+    std::filesystem::resize_file(log_path, contents.size() - in.size());
+    log.emplace(log_path, "ab");
+    logged_records = replayed;
+  }
+
+  void load_snapshot(std::string_view in) {
+    std::string_view whole = in;
+    if (in.size() < header_size + sizeof(std::uint64_t) + sizeof(std::uint32_t) ||
+        in.substr(0, sizeof(snapshot_magic)) != std::string_view(snapshot_magic, sizeof(snapshot_magic))) {
+      throw std::runtime_error("durable_bimap: snapshot is damaged");
+    }
+    std::string_view body = whole.substr(0, whole.size() - sizeof(std::uint32_t));
+    std::string_view tail = whole.substr(body.size());
+    if (*durable_codec<std::uint32_t>::decode(tail) != bimap_details::checksum(body)) {
+      throw std::runtime_error("durable_bimap: snapshot is damaged");
+    }
+    in = body.substr(sizeof(snapshot_magic));
+    generation = *durable_codec<std::uint64_t>::decode(in);
+    std::uint64_t count = *durable_codec<std::uint64_t>::decode(in);
+    std::vector<std::pair<Left, Right>> loaded;
+    loaded.reserve(static_cast<std::size_t>(count));
+    for (std::uint64_t i = 0; i < count; ++i) {
+      std::optional<Left> left = durable_codec<Left>::decode(in);
+      std::optional<Right> right = left ? durable_codec<Right>::decode(in) : std::nullopt;
+      if (!right) {
+        throw std::runtime_error("durable_bimap: snapshot is damaged");
+      }
+      loaded.emplace_back(std::move(*left), std::move(*right));
+    }
+    pairs = bimap_t(std::make_move_iterator(loaded.begin()), std::make_move_iterator(loaded.end()));
+  }
+
+  // Applies the record at the front of `in` and advances past it, or returns false if it is torn. A whole record
+  // was logged only once its change had been made, so one that does not apply means that the log does not belong
+  // to the recovered pairs, and is an error.
+  bool replay_record(std::string_view& in) {
+    std::string_view rest = in;
+    std::optional<std::uint32_t> size = durable_codec<std::uint32_t>::decode(rest);
+    std::optional<std::uint32_t> hash = size ? durable_codec<std::uint32_t>::decode(rest) : std::nullopt;
+    if (!hash || rest.size() < *size || *size == 0 || bimap_details::checksum(rest.substr(0, *size)) != *hash) {
+      return false;
+    }
+    std::string_view payload = rest.substr(1, *size - 1);
+    switch (static_cast<op>(rest[0])) {
+    case op::insert:
+      if (auto [left, right] = decode<Left, Right>(payload); right) {
+        applied(pairs.insert(std::move(*left), std::move(*right)) != pairs.end_left());
+        break;
+      }
+      return false;
+    case op::erase_left:
+      if (auto [left] = decode<Left>(payload); left) {
+        applied(pairs.erase_left(*left));
+        break;
+      }
+      return false;
+    case op::erase_right:
+      if (auto [right] = decode<Right>(payload); right) {
+        applied(pairs.erase_right(*right));
+        break;
+      }
+      return false;
+    case op::replace_left:
+      if (auto [right, left] = decode<Right, Left>(payload); left) {
+        auto it = pairs.find_right(*right);
+        applied(it != pairs.end_right() && pairs.replace_left(it, std::move(*left)) != pairs.end_left());
+        break;
+      }
+      return false;
+    case op::replace_right:
+      if (auto [left, right] = decode<Left, Right>(payload); right) {
+        auto it = pairs.find_left(*left);
+        applied(it != pairs.end_left() && pairs.replace_right(it, std::move(*right)) != pairs.end_right());
+        break;
+      }
+      return false;
+    case op::clear:
+      pairs.clear();
+      break;
+    default:
+      return false;
+    }
+    in = rest.substr(*size);
+    return true;
+  }
+
+  static void applied(bool changed) {
+    if (!changed) {
+      throw std::runtime_error("durable_bimap: log does not match the snapshot");
+    }
+  }
+
+  // Decodes the keys in turn; if one is missing, so are all after it.
+  template <typename... Keys>
+  static std::tuple<std::optional<Keys>...> decode(std::string_view in) {
+    bool whole = true;
+    auto next = [&]<typename Key>(std::type_identity<Key>) {
+      std::optional<Key> key = whole ? durable_codec<Key>::decode(in) : std::nullopt;
+      whole = key.has_value();
+      return key;
+    };
+    return {next(std::type_identity<Keys>())...};
+  }
+
+  std::filesystem::path log_path;
+  std::filesystem::path snapshot_path;
+  options opts;
+  bimap_t pairs;
+  std::optional<bimap_details::durable_file> log;
+  std::string pending;
+  std::size_t pending_records = 0;
+  std::size_t logged_records = 0;
+  std::uint64_t generation = 0;
+};
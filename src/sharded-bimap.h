@@ -0,0 +1,233 @@
+#pragma once
+
+#include "bimap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+
+// A bimap for many threads at once. Pairs are partitioned by the hash of the left key into left shards,
+// each a bimap under its own reader-writer lock, and every right key is also entered, with its left key,
+// into a right shard picked by the hash of the right key, which is a plain map from right keys to left ones.
+// So a lookup by either key locks one shard, and changes to pairs in different shards do not contend.
+//
+// A change locks the left shard of the pair first and then its right shard, and never holds two shards
+// of the same side, so locks are always taken in the same order and cannot deadlock. `insert` holds both
+// while it checks both keys and enters the pair into both shards, so both sides always agree. `erase_right`
+// has to look the left key up before it knows which left shard to lock: it reads it under the right shard
+// alone, takes both locks in order and starts over if the pair has changed in between.
+template <
+    typename Left,
+    typename Right,
+    typename LeftHash = std::hash<Left>,
+    typename RightHash = std::hash<Right>,
+    typename CompareLeft = std::less<Left>,
+    typename CompareRight = std::less<Right>,
+    typename Policy = bimap_policy::standard>
+class sharded_bimap {
+  template <typename Map>
+  struct alignas(bimap_details::cache_line_size) shard {
+    template <typename... Compare>
+    explicit shard(const Compare&... compare)
+        : pairs(compare...) {}
+
+    mutable std::shared_mutex mutex;
+    Map pairs;
+  };
+
+  // A fixed number of shards built in place from the same comparators, which need not be default-constructible.
+  template <typename Shard>
+  class shard_array {
+  public:
+    template <typename... Compare>
+    shard_array(std::size_t size, const Compare&... compare)
+        : shards(std::allocator<Shard>().allocate(size))
+        , size(size) {
+      try {
+        for (; built < size; ++built) {
+          std::construct_at(shards + built, compare...);
+        }
+      } catch (...) {
+        destroy();
+        throw;
+      }
+    }
+
+    shard_array(const shard_array&) = delete;
+    shard_array& operator=(const shard_array&) = delete;
+
+    ~shard_array() {
+      destroy();
+    }
+
+    Shard& operator[](std::size_t index) const noexcept {
+      return shards[index];
+    }
+
+  private:
+    void destroy() noexcept {
+      std::destroy_n(shards, built);
+      std::allocator<Shard>().deallocate(shards, size);
+    }
+
+    Shard* shards;
+    std::size_t size;
+    std::size_t built = 0;
+  };
+
+  using left_shard = shard<bimap<Left, Right, CompareLeft, CompareRight, Policy>>;
+  using right_shard = shard<std::map<Right, Left, CompareRight>>;
+
+public:
+  // Every left shard gets copies of both comparators, every right shard a copy of `compare_right`.
+  explicit sharded_bimap(
+      std::size_t shards = 64,
+      LeftHash left_hash = LeftHash(),
+      RightHash right_hash = RightHash(),
+      const CompareLeft& compare_left = CompareLeft(),
+      const CompareRight& compare_right = CompareRight()
+  )
+      : shard_count(std::clamp<std::size_t>(shards, 1, std::numeric_limits<std::uint32_t>::max()))
+      , left_shards(shard_count, compare_left, compare_right)
+      , right_shards(shard_count, compare_right)
+      , left_hash(std::move(left_hash))
+      , right_hash(std::move(right_hash)) {}
+
+  sharded_bimap(const sharded_bimap&) = delete;
+  sharded_bimap& operator=(const sharded_bimap&) = delete;
+
+  // Inserts the pair if neither key is taken, and returns whether it did.
+  bool insert(const Left& left, const Right& right) {
+    left_shard& ls = left_shards[left_index(left)];
+    right_shard& rs = right_shards[right_index(right)];
+    std::unique_lock left_lock(ls.mutex);
+    std::unique_lock right_lock(rs.mutex);
+    if (ls.pairs.find_left(left) != ls.pairs.end_left() || rs.pairs.contains(right)) {
+      return false;
+    }
+    ls.pairs.insert(left, right);
+    try {
+      rs.pairs.emplace(right, left);
+    } catch (...) {
+      ls.pairs.erase_left(left);
+      throw;
+    }
+    count.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool erase_left(const Left& left) {
+    left_shard& ls = left_shards[left_index(left)];
+    std::unique_lock left_lock(ls.mutex);
+    auto it = ls.pairs.find_left(left);
+    if (it == ls.pairs.end_left()) {
+      return false;
+    }
+    right_shard& rs = right_shards[right_index(*it.flip())];
+    std::unique_lock right_lock(rs.mutex);
+    rs.pairs.erase(*it.flip());
+    ls.pairs.erase_left(it);
+    count.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool erase_right(const Right& right) {
+    right_shard& rs = right_shards[right_index(right)];
+    while (true) {
+      std::size_t index;
+      {
+        std::shared_lock right_lock(rs.mutex);
+        auto it = rs.pairs.find(right);
+        if (it == rs.pairs.end()) {
+          return false;
+        }
+        index = left_index(it->second);
+      }
+      left_shard& ls = left_shards[index];
+      std::unique_lock left_lock(ls.mutex);
+      std::unique_lock right_lock(rs.mutex);
+      auto it = rs.pairs.find(right);
+      if (it == rs.pairs.end()) {
+        return false;
+      }
+      if (left_index(it->second) == index) {
+        ls.pairs.erase_left(it->second);
+        rs.pairs.erase(it);
+        count.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+  }
+
+  std::optional<Right> find_left(const Left& left) const {
+    const left_shard& ls = left_shards[left_index(left)];
+    std::shared_lock lock(ls.mutex);
+    auto it = ls.pairs.find_left(left);
+    if (it == ls.pairs.end_left()) {
+      return std::nullopt;
+    }
+    return *it.flip();
+  }
+
+  std::optional<Left> find_right(const Right& right) const {
+    const right_shard& rs = right_shards[right_index(right)];
+    std::shared_lock lock(rs.mutex);
+    auto it = rs.pairs.find(right);
+    if (it == rs.pairs.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  // Exact once concurrent changes are over.
+  std::size_t size() const noexcept {
+    return count.load(std::memory_order_relaxed);
+  }
+
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  // Calls `f(left, right)` for every pair, one left shard at a time, each under a shared lock.
+  template <typename F>
+  void for_each(F f) const {
+    for (std::size_t i = 0; i < shard_count; ++i) {
+      std::shared_lock lock(left_shards[i].mutex);
+      for (auto it = left_shards[i].pairs.begin_left(); it != left_shards[i].pairs.end_left(); ++it) {
+        f(*it, *it.flip());
+      }
+    }
+  }
+
+private:
+  // The shard comes from the high bits of the product with a large odd constant, so that a weak hash,
+  // such as the identity for integers, still spreads sequential keys over all shards.
+  std::size_t shard_of(std::size_t hash) const noexcept {
+    std::uint64_t mixed = static_cast<std::uint64_t>(hash) * 0x9e3779b97f4a7c15u;
+    return static_cast<std::size_t>(((mixed >> 32) * shard_count) >> 32);
+  }
+
+  std::size_t left_index(const Left& left) const {
+    return shard_of(left_hash(left));
+  }
+
+  std::size_t right_index(const Right& right) const {
+    return shard_of(right_hash(right));
+  }
+
+  std::size_t shard_count;
+  shard_array<left_shard> left_shards;
+  shard_array<right_shard> right_shards;
+  [[no_unique_address]] LeftHash left_hash;
+  [[no_unique_address]] RightHash right_hash;
+  std::atomic<std::size_t> count = 0;
+};
@@ -4,10 +4,34 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include <algorithm>
+#include <coroutine>
+#include <cstdint>
+#include <execution>
+#include <numeric>
 #include <random>
+#include <string>
+#include <vector>
 
 template class bimap<int, non_default_constructible>;
 template class bimap<non_default_constructible, int>;
+template class bimap<int, int, std::less<int>, std::less<int>, bimap_policy::compact>;
+
+namespace {
+
+struct unbalanced : bimap_policy::standard {
+  static constexpr std::size_t height_factor = 0;
+};
+
+// A `state_comparator` that cannot throw, so that copy assignment may reuse nodes.
+struct nothrow_state_comparator : state_comparator {
+  using state_comparator::state_comparator;
+
+  bool operator()(int lhs, int rhs) const noexcept {
+    return state_comparator::operator()(lhs, rhs);
+  }
+};
+
+} // namespace
 
 TEST_CASE("Simple") {
   bimap<int, int> b;
@@ -70,6 +94,75 @@ TEST_CASE("Custom parameterized comparator") {
   }
 }
 
+TEST_CASE("Three-way comparator") {
+  size_t calls = 0;
+  bimap<int, int, three_way_comparator, three_way_comparator, unbalanced> b(three_way_comparator{&calls});
+  for (int i = 1; i <= 10; i++) {
+    b.insert(i, -i);
+  }
+  CHECK(*b.begin_left() == 10);
+  CHECK(*b.begin_right() == -1);
+
+  calls = 0;
+  CHECK(*b.find_left(10) == 10);
+  CHECK(calls == 10);
+
+  CHECK(b.at_left(4) == -4);
+  CHECK(b.at_right(-7) == 7);
+  CHECK(b.find_left(11) == b.end_left());
+  CHECK(*b.lower_bound_left(5) == 5);
+  CHECK(*b.upper_bound_left(5) == 4);
+  CHECK(*b.lower_bound_right(0) == -1);
+  CHECK(b.insert(3, 100) == b.end_left());
+
+  auto copy = b;
+  CHECK(copy == b);
+  CHECK(b.erase_left(5));
+  CHECK(copy != b);
+}
+
+TEST_CASE("Key with three-way comparison") {
+  bimap<std::string, std::string> b;
+  b.insert("apple", "red");
+  b.insert("banana", "yellow");
+  b.insert("cherry", "dark red");
+
+  CHECK(b.at_left("banana") == "yellow");
+  CHECK(b.at_right("red") == "apple");
+  CHECK(*b.lower_bound_left("b") == "banana");
+  CHECK(*b.upper_bound_left("banana") == "cherry");
+  CHECK(b.upper_bound_right("yellow") == b.end_right());
+  CHECK(b.insert("apple", "green") == b.end_left());
+  CHECK(b.find_right("green") == b.end_right());
+}
+
+TEST_CASE("Comparator with projection") {
+  using vec = std::pair<int, int>;
+  vector_compare manhattan(vector_compare::manhattan);
+  bimap<vec, vec, vector_compare, vector_compare> b(manhattan, manhattan);
+  b.insert({3, 4}, {1, 1});
+  b.insert({0, 1}, {5, 5});
+  b.insert({-2, 2}, {0, 0});
+
+  CHECK(b.insert({4, 3}, {7, 7}) == b.end_left());
+  CHECK(b.insert({9, 9}, {-1, -1}) == b.end_left());
+  CHECK(b.size() == 3);
+
+  CHECK(b.at_left({7, 0}) == vec{1, 1});
+  CHECK(b.at_right({2, 0}) == vec{3, 4});
+  CHECK(*b.lower_bound_left({1, 1}) == vec{-2, 2});
+  CHECK(*b.upper_bound_left({1, 3}) == vec{3, 4});
+  CHECK(b.find_left({1, 1}) == b.end_left());
+
+  CHECK(*b.replace_left(b.find_right({0, 0}), {0, 10}) == vec{0, 10});
+  CHECK(*b.begin_left().flip() == vec{5, 5});
+  CHECK(*std::prev(b.end_left()).flip() == vec{0, 0});
+
+  auto copy = b;
+  CHECK(copy == b);
+  CHECK(copy.at_right({0, 0}) == vec{0, 10});
+}
+
 TEST_CASE("Comparator with state") {
   bimap<int, int, state_comparator, state_comparator> a(state_comparator(true));
   a.insert(1, 2);
@@ -218,6 +311,199 @@ TEST_CASE("Insert xvalue") {
   }
 }
 
+namespace {
+
+class pinned {
+public:
+  explicit pinned(int value, int scale = 1)
+      : value(value * scale) {}
+
+  pinned(const pinned&) = delete;
+  pinned& operator=(const pinned&) = delete;
+
+  friend auto operator<=>(const pinned&, const pinned&) = default;
+
+  int value;
+};
+
+} // namespace
+
+TEST_CASE("Insert range") {
+  bimap<int, std::string> b;
+  std::vector<std::pair<int, std::string>> batch = {{3, "c"}, {1, "a"}, {2, "a"}, {1, "b"}, {4, "d"}, {2, "e"}};
+  CHECK(b.insert_range(batch.begin(), batch.end()) == 4);
+  CHECK(b.size() == 4);
+  CHECK(b.at_left(1) == "a");
+  CHECK(b.at_left(2) == "e");
+  CHECK(b.find_right("b") == b.end_right());
+
+  std::pair<int, std::string> more[] = {{0, "z"}, {5, "c"}, {6, "f"}};
+  CHECK(b.insert_range(std::begin(more), std::end(more)) == 2);
+  CHECK(*b.begin_left() == 0);
+  CHECK(*std::prev(b.end_right()) == "z");
+
+  std::vector<std::pair<int, std::string>> moved = {{7, std::string(100, 'g')}};
+  CHECK(b.insert_range(std::make_move_iterator(moved.begin()), std::make_move_iterator(moved.end())) == 1);
+  CHECK(moved[0].second.empty());
+  CHECK(b.insert_range(moved.begin(), moved.begin()) == 0);
+  CHECK(b.size() == 7);
+
+  std::vector<std::tuple<int, std::string>> tuples = {{8, "h"}, {9, "i"}};
+  CHECK(b.insert_range(tuples.begin(), tuples.end()) == 2);
+  CHECK(b.at_right("i") == 9);
+}
+
+TEST_CASE("Range constructor") {
+  std::vector<std::pair<int, std::string>> pairs = {{3, "c"}, {1, "a"}, {2, "a"}, {1, "b"}, {4, "d"}};
+  bimap<int, std::string> b(pairs.begin(), pairs.end());
+  CHECK(b.size() == 3);
+  CHECK(b.at_left(1) == "a");
+  CHECK(b.find_left(2) == b.end_left());
+
+  bimap<int, std::string> par(std::execution::par, pairs.begin(), pairs.end());
+  CHECK(par == b);
+  bimap<int, std::string> seq(std::execution::seq, pairs.begin(), pairs.begin());
+  CHECK(seq.empty());
+}
+
+TEST_CASE("Batch find") {
+  std::vector<std::pair<int, int>> pairs(1'000);
+  for (int i = 0; i < 1'000; ++i) {
+    pairs[i] = {i * 2, -i};
+  }
+  bimap<int, int> b(std::execution::par_unseq, pairs.begin(), pairs.end());
+  REQUIRE(b.size() == 1'000);
+
+  std::vector<int> keys(3'000);
+  std::iota(keys.begin(), keys.end(), -500);
+  std::vector<bimap<int, int>::left_iterator> lefts(keys.size());
+  CHECK(b.find_left(std::execution::par, keys.begin(), keys.end(), lefts.begin()) == lefts.end());
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    CHECK(lefts[i] == b.find_left(keys[i]));
+  }
+
+  std::vector<bimap<int, int>::right_iterator> rights(keys.size());
+  b.find_right(std::execution::seq, keys.begin(), keys.end(), rights.begin());
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    CHECK(rights[i] == b.find_right(keys[i]));
+  }
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+// For the coroutines below, as in bimap.h.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+
+TEST_CASE("Async lookup") {
+  bimap<std::string, int, std::less<std::string>, three_way_comparator> b;
+  b.insert("a", 1);
+  b.insert("b", 2);
+  b.insert("c", 3);
+  CHECK(*b.find_left_async("b").get().flip() == 2);
+  CHECK(b.find_right_async(4).get() == b.end_right());
+
+  std::vector<std::string> found;
+  int turns = 0;
+  lookup_scheduler scheduler;
+  for (int key : {3, 5, 1}) {
+    scheduler.spawn([](const auto& map, int right, auto& lefts, int& resumed) -> lookup_scheduler::task {
+      ++resumed;
+      co_await std::suspend_always();
+      ++resumed;
+      auto it = co_await map.find_right_async(right);
+      lefts.push_back(it == map.end_right() ? "" : *it.flip());
+    }(b, key, found, turns));
+  }
+  CHECK(scheduler.size() == 3);
+  scheduler.run();
+  CHECK(turns == 6);
+  std::sort(found.begin(), found.end());
+  CHECK(found == std::vector<std::string>{"", "a", "c"});
+  CHECK(scheduler.size() == 0);
+}
+
+TEST_CASE("Async lookup rethrows") {
+  bimap<int, int, expiring_comparator, expiring_comparator> b(expiring_comparator(true), expiring_comparator(true));
+  b.insert(1, 2);
+  CHECK_THROWS_AS(b.find_left_async(1).get(), std::runtime_error);
+
+  bool done = false;
+  lookup_scheduler scheduler;
+  scheduler.spawn([](const auto& b) -> lookup_scheduler::task {
+    co_await b.find_right_async(2);
+  }(b));
+  scheduler.spawn([](bool& resumed) -> lookup_scheduler::task {
+    co_await std::suspend_always();
+    resumed = true;
+  }(done));
+  CHECK_THROWS_AS(scheduler.run(), std::runtime_error);
+  CHECK(scheduler.size() == 1);
+  scheduler.run();
+  CHECK(done);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic pop
+#endif
+
+TEST_CASE("Emplace") {
+  int moves = 0;
+  bimap<counter_moved, counter_moved> b;
+  auto it = b.emplace(std::piecewise_construct, std::forward_as_tuple(1, &moves), std::forward_as_tuple(2, &moves));
+  CHECK(moves == 0);
+  CHECK(it == b.begin_left());
+  CHECK(b.size() == 1);
+
+  CHECK(
+      b.emplace(std::piecewise_construct, std::forward_as_tuple(1, &moves), std::forward_as_tuple(3, &moves)) ==
+      b.end_left()
+  );
+  CHECK(
+      b.emplace(std::piecewise_construct, std::forward_as_tuple(4, &moves), std::forward_as_tuple(2, &moves)) ==
+      b.end_left()
+  );
+  CHECK(b.size() == 1);
+  CHECK(moves == 0);
+
+  b.insert(counter_moved(5, &moves), counter_moved(6, &moves));
+  CHECK(moves == 2);
+
+  bimap<pinned, pinned> p;
+  p.emplace(std::piecewise_construct, std::forward_as_tuple(3, 2), std::forward_as_tuple(4));
+  p.emplace(std::piecewise_construct, std::forward_as_tuple(1), std::forward_as_tuple(5));
+  CHECK(p.begin_left()->value == 1);
+  CHECK(p.begin_right()->value == 4);
+  CHECK(p.begin_right().flip()->value == 6);
+  CHECK(p.size() == 2);
+}
+
+TEST_CASE("Try emplace") {
+  int moves = 0;
+  bimap<int, counter_moved> b;
+  auto it = b.try_emplace_left(1, 10, &moves);
+  CHECK(*it == 1);
+  CHECK(moves == 0);
+  CHECK(b.try_emplace_left(1, 11, &moves) == b.end_left());
+  CHECK(b.try_emplace_left(2, 10, &moves) == b.end_left());
+  CHECK(b.size() == 1);
+
+  auto rit = b.try_emplace_right(counter_moved(20, &moves), 2);
+  CHECK(moves == 1);
+  CHECK(*rit.flip() == 2);
+  CHECK(b.try_emplace_right(counter_moved(20, &moves), 3) == b.end_right());
+  CHECK(moves == 1);
+
+  bimap<std::string, pinned> p;
+  std::string key = "key";
+  CHECK(p.try_emplace_left(std::move(key), 7)->size() == 3);
+  CHECK(key.empty());
+  std::string taken = "key";
+  CHECK(p.try_emplace_left(std::move(taken), 8) == p.end_left());
+  CHECK(taken == "key");
+  CHECK(p.at_left("key").value == 7);
+}
+
 TEST_CASE("At") {
   bimap<int, int> b;
   b.insert(4, 3);
@@ -258,6 +544,35 @@ TEST_CASE("At-or-default") {
   CHECK(b.at_right(-1000) == 0);
 }
 
+TEST_CASE("At-or-default relinks existing pair") {
+  bimap<int, int> b;
+  std::mt19937 rng(std::mt19937::default_seed);
+  std::uniform_int_distribution<int> dist(-1000, 1000);
+  for (int i = 0; i < 200; i++) {
+    b.insert(dist(rng), i + 1);
+  }
+  b.insert(5000, 0);
+  size_t size = b.size();
+
+  for (int i = 0; i < 500; i++) {
+    int key = dist(rng);
+    bool existed = b.find_left(key) != b.end_left();
+    int expected = existed ? b.at_left(key) : 0;
+    REQUIRE(b.at_left_or_default(key) == expected);
+    REQUIRE(b.size() == size);
+    if (!existed) {
+      REQUIRE(b.at_right(0) == key);
+    }
+
+    int prev = *b.begin_left();
+    for (auto it = std::next(b.begin_left()); it != b.end_left(); ++it) {
+      REQUIRE(prev < *it);
+      REQUIRE(b.find_right(*it.flip()).flip() == it);
+      prev = *it;
+    }
+  }
+}
+
 TEST_CASE("At-or-default does not invoke copy assignment") {
   bimap<non_copy_assignable, non_copy_assignable> b;
   b.insert(non_copy_assignable(4), non_copy_assignable(2));
@@ -269,6 +584,54 @@ TEST_CASE("At-or-default does not invoke copy assignment") {
   CHECK(b.at_right_or_default(non_copy_assignable(1)) == non_copy_assignable(0));
 }
 
+TEST_CASE("Replace") {
+  bimap<int, int> b;
+  b.insert(1, 10);
+  b.insert(2, 20);
+  b.insert(3, 30);
+  b.insert(4, 40);
+
+  auto it = b.replace_left(b.find_right(20), 5);
+  CHECK(*it == 5);
+  CHECK(*it.flip() == 20);
+  CHECK(b.at_right(20) == 5);
+  CHECK(b.find_left(2) == b.end_left());
+
+  auto rit = b.replace_right(b.find_left(3), 0);
+  CHECK(*rit == 0);
+  CHECK(*b.begin_right() == 0);
+  CHECK(b.at_left(3) == 0);
+  CHECK(b.find_right(30) == b.end_right());
+
+  CHECK(b.replace_left(b.find_right(10), 4) == b.end_left());
+  CHECK(b.at_left(1) == 10);
+  CHECK(b.at_left(4) == 40);
+
+  CHECK(*b.replace_right(b.find_left(4), 40) == 40);
+  CHECK(b.size() == 4);
+
+  std::vector<int> lefts, rights;
+  for (auto l = b.begin_left(); l != b.end_left(); ++l) {
+    lefts.push_back(*l);
+  }
+  for (auto r = b.begin_right(); r != b.end_right(); ++r) {
+    rights.push_back(*r);
+  }
+  CHECK(lefts == std::vector<int>{1, 3, 4, 5});
+  CHECK(rights == std::vector<int>{0, 10, 20, 40});
+}
+
+TEST_CASE("Replace with non-copyable type") {
+  bimap<test_object, test_object> b;
+  b.insert(test_object(1), test_object(2));
+  b.insert(test_object(3), test_object(4));
+
+  auto it = b.replace_left(b.find_right(test_object(4)), test_object(0));
+  CHECK(it == b.begin_left());
+  CHECK(it.flip()->a == 4);
+  CHECK(b.begin_right().flip()->a == 1);
+}
+
 TEST_CASE("Flip end iterator") {
   bimap<int, int> b;
   CHECK(b.end_left().flip() == b.end_right());
@@ -347,6 +710,380 @@ TEST_CASE("Empty") {
   CHECK(b.empty());
 }
 
+TEST_CASE("Clear") {
+  bimap<int, int> b;
+  b.clear();
+  CHECK(b.empty());
+
+  for (int i = 0; i < 5000; i++) {
+    b.insert(i, -i);
+  }
+  b.clear();
+  CHECK(b.empty());
+  CHECK(b.size() == 0);
+  CHECK(b.begin_left() == b.end_left());
+  CHECK(b.begin_right() == b.end_right());
+
+  b.insert(1, 2);
+  CHECK(b.at_left(1) == 2);
+  CHECK(b.at_right(2) == 1);
+}
+
+TEST_CASE("Threaded policy") {
+  using threaded_bimap = bimap<int, int, std::less<int>, std::less<int>, bimap_policy::threaded>;
+  threaded_bimap a;
+  CHECK(a.begin_left() == a.end_left());
+
+  for (int i = 0; i < 10; i++) {
+    a.insert(i, 20 - i);
+  }
+  CHECK(*a.begin_left() == 0);
+  CHECK(*a.begin_right() == 11);
+  CHECK(*std::prev(a.end_left()) == 9);
+  CHECK(*std::next(a.find_right(15)) == 16);
+  CHECK(*std::next(a.find_right(15).flip()) == 6);
+
+  threaded_bimap b;
+  b.insert(100, 100);
+  swap(a, b);
+  CHECK(*std::prev(a.end_right()) == 100);
+  CHECK(std::distance(b.begin_left(), b.end_left()) == 10);
+  CHECK(std::distance(b.begin_right(), b.end_right()) == 10);
+
+  threaded_bimap c = std::move(b);
+  CHECK(b.begin_left() == b.end_left());
+  CHECK(std::distance(c.begin_right(), c.end_right()) == 10);
+  a = c;
+  CHECK(a == c);
+  CHECK(*std::prev(a.end_left()) == 9);
+
+  c.erase_left(c.find_left(3), c.find_left(7));
+  CHECK(*std::next(c.find_left(2)) == 7);
+  CHECK(*std::prev(c.find_right(18)) == 13);
+  c.clear();
+  CHECK(c.begin_right() == c.end_right());
+  c.insert(1, 1);
+  CHECK(*c.begin_left() == 1);
+}
+
+TEST_CASE("Compact policy") {
+  using compact_bimap = bimap<int, int, std::less<int>, std::less<int>, bimap_policy::compact>;
+  STATIC_CHECK(sizeof(compact_bimap::node_t) * 2 <= sizeof(bimap<int, int>::node_t) + sizeof(int) * 2);
+  STATIC_CHECK(sizeof(compact_bimap::left_iterator) <= sizeof(void*));
+
+  compact_bimap a;
+  CHECK(a.begin_left() == a.end_left());
+  for (int i = 0; i < 100; i++) {
+    a.insert(i, 1000 - i);
+  }
+  CHECK(a.at_left(42) == 958);
+  CHECK(*std::prev(a.end_right()) == 1000);
+
+  compact_bimap b;
+  b.insert(-1, -1);
+  auto it = a.find_left(50);
+  swap(a, b);
+  CHECK(*it.flip() == 950);
+  CHECK(std::next(it) == b.find_left(51));
+
+  compact_bimap c = std::move(b);
+  CHECK(*it.flip() == 950);
+  CHECK(c.size() == 100);
+  a = c;
+  CHECK(a == c);
+
+  c.erase_left(c.find_left(10), c.find_left(90));
+  CHECK(c.size() == 20);
+  CHECK(*std::next(c.find_left(9)) == 90);
+  c.clear();
+  CHECK(c.empty());
+  c.insert(1, 2);
+  CHECK(c.at_right(2) == 1);
+}
+
+TEST_CASE("Compact pool grows only to allocate a node") {
+  bimap<int, int, std::less<int>, std::less<int>, bimap_policy::compact> b;
+  b.reserve(4);
+  for (int i = 0; i < 4; i++) {
+    b.insert(i, 10 + i);
+  }
+  REQUIRE(b.size() == b.capacity());
+
+  std::size_t capacity = b.capacity();
+  auto it = b.find_left(2);
+  const int& right = b.at_left(2);
+  CHECK(b.insert(2, 42) == b.end_left());
+  CHECK(b.insert(42, 12) == b.end_left());
+  CHECK(b.try_emplace_left(3, 42) == b.end_left());
+  CHECK(b.try_emplace_right(13, 42) == b.end_right());
+  CHECK(b.try_emplace_left(42, 12) == b.end_left());
+  CHECK(b.try_emplace_right(42, 3) == b.end_right());
+  CHECK(b.at_left_or_default(1) == 11);
+  CHECK(b.at_right_or_default(10) == 0);
+  CHECK(b.emplace(std::piecewise_construct, std::forward_as_tuple(1), std::forward_as_tuple(42)) == b.end_left());
+  std::pair<int, int> clashes[] = {{0, 50}, {1, 51}, {60, 12}, {61, 13}, {62, 62}, {62, 63}};
+  CHECK(b.insert_range(std::begin(clashes), std::begin(clashes) + 4) == 0);
+  CHECK(b.capacity() == capacity);
+  CHECK(*it == 2);
+  CHECK(&*it.flip() == &right);
+
+  CHECK(b.insert(4, 14) != b.end_left());
+  CHECK(b.capacity() > capacity);
+  CHECK(b.at_left(2) == 12);
+
+  CHECK(b.insert_range(std::begin(clashes), std::end(clashes)) == 1);
+  CHECK(b.at_left(62) == 62);
+  CHECK(b.size() == 6);
+}
+
+TEST_CASE("Compact policy with non-trivial keys") {
+  bimap<std::string, test_object, std::less<std::string>, std::less<test_object>, bimap_policy::compact> b;
+  for (int i = 0; i < 200; i++) {
+    b.insert(std::to_string(i), test_object(i));
+  }
+  for (int i = 0; i < 200; i += 2) {
+    b.erase_left(std::to_string(i));
+  }
+  for (int i = 200; i < 300; i++) {
+    b.insert(std::to_string(i), test_object(i));
+  }
+  CHECK(b.size() == 200);
+  CHECK(b.at_left("151") == test_object(151));
+  CHECK(b.at_right(test_object(299)) == "299");
+  b.replace_left(b.find_right(test_object(151)), "x");
+  CHECK(b.at_right(test_object(151)) == "x");
+  CHECK(b.find_left("151") == b.end_left());
+  b.emplace(std::piecewise_construct, std::forward_as_tuple("y"), std::forward_as_tuple(1000));
+  CHECK(b.at_left("y") == test_object(1000));
+  b.clear();
+  CHECK(b.empty());
+  b.insert("z", test_object(1));
+  CHECK(b.at_right(test_object(1)) == "z");
+}
+
+TEST_CASE("Compact clear frees the pool at once") {
+  bimap<int, int, std::less<int>, std::less<int>, bimap_policy::compact> b;
+  for (int i = 0; i < 100; i++) {
+    b.insert(i, i);
+  }
+  for (int i = 0; i < 100; i += 3) {
+    b.erase_left(i);
+  }
+  std::size_t capacity = b.capacity();
+  b.clear();
+  CHECK(b.empty());
+  CHECK(b.capacity() == capacity);
+
+  // No slot is left on the free list, so the slots are handed out in order again.
+  for (int i = 0; i < 100; i++) {
+    b.insert(i, -i);
+  }
+  CHECK(b.capacity() == capacity);
+  for (int i = 1; i < 100; i++) {
+    CHECK(std::less<const int*>()(&*b.find_left(i - 1), &*b.find_left(i)));
+  }
+}
+
+TEST_CASE("Split policy") {
+  using split_bimap = bimap<std::string, int, std::less<std::string>, std::less<int>, bimap_policy::split>;
+  split_bimap b;
+  for (int i = 0; i < 100; i++) {
+    b.insert(std::to_string(i), i);
+  }
+  auto it = b.find_left("42");
+  auto left = reinterpret_cast<std::uintptr_t>(&*it);
+  auto right = reinterpret_cast<std::uintptr_t>(&*it.flip());
+  CHECK(left / 64 != right / 64);
+  CHECK(right % 64 < sizeof(void*) * 3 + sizeof(int));
+
+  split_bimap c = b;
+  CHECK(b == c);
+  c.erase_right(c.find_right(10), c.find_right(90));
+  CHECK(c.size() == 20);
+  CHECK(c.at_right(95) == "95");
+  c.emplace(std::piecewise_construct, std::forward_as_tuple(3, 'x'), std::forward_as_tuple(-1));
+  c.try_emplace_right(-2, "yy");
+  CHECK(c.at_left("xxx") == -1);
+  CHECK(c.at_right(-2) == "yy");
+}
+
+TEST_CASE("Small policy") {
+  using small_bimap = bimap<int, std::string, std::less<int>, std::less<std::string>, bimap_policy::small<3>>;
+  small_bimap a;
+  a.insert(1, "one");
+  a.insert(2, "two");
+  CHECK(a.at_right("two") == 2);
+  CHECK(a.find_left(3) == a.end_left());
+
+  for (int i = 3; i < 10; i++) {
+    a.insert(i, std::to_string(i));
+  }
+  auto heap_it = a.find_left(9);
+  a.erase_left(1);
+  a.insert(0, "zero");
+  CHECK(a.at_left(0) == "zero");
+  CHECK(*a.begin_left() == 0);
+
+  small_bimap b;
+  b.insert(100, "hundred");
+  swap(a, b);
+  CHECK(b.size() == 9);
+  CHECK(*heap_it.flip() == "9");
+  CHECK(std::next(heap_it) == b.end_left());
+  CHECK(a.at_left(100) == "hundred");
+  CHECK(*b.begin_right() == "3");
+
+  small_bimap c = std::move(b);
+  CHECK(c.size() == 9);
+  CHECK(c.at_right("two") == 2);
+  CHECK(b.empty());
+  b = c;
+  CHECK(b == c);
+  swap(b, b);
+  CHECK(b == c);
+  c.erase_left(c.begin_left(), c.end_left());
+  CHECK(c.empty());
+}
+
+TEST_CASE("Splay policy") {
+  size_t calls = 0;
+  using splay_bimap = bimap<int, int, three_way_comparator, three_way_comparator, bimap_policy::splay>;
+  splay_bimap b(three_way_comparator{&calls}, three_way_comparator{&calls});
+  for (int i = 0; i < 1000; i++) {
+    b.insert(i, -i);
+  }
+  const splay_bimap& view = b;
+
+  calls = 0;
+  CHECK(*view.find_left(123) == 123);
+  size_t const_calls = calls;
+  calls = 0;
+  CHECK(*view.find_left(123) == 123);
+  CHECK(calls == const_calls);
+
+  auto it = b.find_left(123);
+  CHECK(*it.flip() == -123);
+  calls = 0;
+  CHECK(*b.find_left(123) == 123);
+  CHECK(calls == 1);
+  CHECK(b.at_right(-777) == 777);
+  calls = 0;
+  CHECK(view.at_right(-777) == 777);
+  CHECK(calls == 1);
+  CHECK(b.find_right(1) == b.end_right());
+  CHECK_THROWS_AS(b.at_left(1000), std::out_of_range);
+
+  CHECK(*std::next(it) == 122);
+  CHECK(*std::prev(it) == 124);
+  int expected = 999;
+  for (auto left = b.begin_left(); left != b.end_left(); ++left) {
+    CHECK(*left == expected--);
+  }
+  CHECK(expected == -1);
+}
+
+TEST_CASE("Reserve and shrink_to_fit") {
+  bimap<int, int> a;
+  CHECK(a.capacity() == 0);
+  a.insert(1, 1);
+  a.reserve(10);
+  CHECK(a.capacity() == 11);
+  a.reserve(5);
+  CHECK(a.capacity() == 11);
+  a.insert(2, 2);
+  CHECK(a.capacity() == 11);
+  a.clear();
+  CHECK(a.capacity() == 9);
+  a.shrink_to_fit();
+  CHECK(a.capacity() == 0);
+
+  bimap<int, int, std::less<int>, std::less<int>, bimap_policy::small<4>> b;
+  CHECK(b.capacity() == 4);
+  b.reserve(6);
+  CHECK(b.capacity() == 6);
+  b.shrink_to_fit();
+  CHECK(b.capacity() == 4);
+
+  using compact_bimap = bimap<int, std::string, std::less<int>, std::less<std::string>, bimap_policy::compact>;
+  compact_bimap c;
+  c.reserve(100);
+  CHECK(c.capacity() == 100);
+  for (int i = 0; i < 50; i++) {
+    c.insert(i, std::to_string(i));
+  }
+  CHECK(c.capacity() == 100);
+  for (int i = 0; i < 50; i += 3) {
+    c.erase_left(i);
+  }
+  compact_bimap expected = c;
+  c.shrink_to_fit();
+  CHECK(c.capacity() == c.size());
+  CHECK(c == expected);
+  CHECK(std::equal(c.begin_right(), c.end_right(), expected.begin_right(), expected.end_right()));
+  CHECK(c.at_right("49") == 49);
+  c.insert(-1, "minus one");
+  CHECK(*c.begin_left() == -1);
+  c.clear();
+  c.shrink_to_fit();
+  CHECK(c.capacity() == 0);
+  c.insert(1, "one");
+  CHECK(c.at_left(1) == "one");
+}
+
+namespace {
+
+template <typename Policy>
+void check_sorted_insertions(int n) {
+  bimap<int, int, std::less<int>, std::less<int>, Policy> b;
+  for (int i = 0; i < n; i++) {
+    b.insert(i, -i);
+  }
+  for (int i = n; i-- > 0;) {
+    b.insert(n + i, n - i);
+  }
+  REQUIRE(b.size() == 2 * n);
+  int expected = 0;
+  for (auto it = b.begin_left(); it != b.end_left(); ++it, ++expected) {
+    REQUIRE(*it == expected);
+  }
+  auto it = b.end_right();
+  for (int right = n; right > -n; right--) {
+    --it;
+    REQUIRE(*it == right);
+  }
+  REQUIRE(it == b.begin_right());
+}
+
+} // namespace
+
+TEST_CASE("Sorted insertions") {
+  check_sorted_insertions<bimap_policy::standard>(100'000);
+  check_sorted_insertions<bimap_policy::threaded>(100'000);
+  check_sorted_insertions<bimap_policy::compact>(100'000);
+  check_sorted_insertions<bimap_policy::split>(100'000);
+  check_sorted_insertions<bimap_policy::small<8>>(100'000);
+  check_sorted_insertions<unbalanced>(100);
+}
+
+TEST_CASE("Rebalance") {
+  bimap<int, std::string, std::less<int>, std::less<std::string>, unbalanced> b;
+  b.rebalance();
+  for (int i = 0; i < 100; i++) {
+    b.insert(i, std::to_string(i));
+  }
+  auto it = b.find_left(42);
+  b.rebalance();
+  CHECK(*it.flip() == "42");
+  CHECK(*std::next(it) == 43);
+  CHECK(*std::prev(it.flip()) == "41");
+  CHECK(b.size() == 100);
+  CHECK(b.lower_bound_right("5") == b.find_right("5"));
+  b.erase_left(b.begin_left(), it);
+  b.rebalance();
+  CHECK(*b.begin_left() == 42);
+  CHECK(b.at_right("99") == 99);
+}
+
 TEST_CASE("Erase iterator") {
   bimap<int, int> b;
 
@@ -422,6 +1159,24 @@ TEST_CASE("Lower bound") {
   } while (std::next_permutation(data.begin(), data.end()));
 }
 
+TEST_CASE("Bounds with arithmetic keys") {
+  bimap<double, long, std::less<>, std::less<>> b;
+  for (int i = 0; i < 100; i++) {
+    b.insert((i * 37 % 100) / 4.0, i * 37 % 100 * 2L);
+  }
+
+  CHECK(*b.lower_bound_left(2.5) == 2.5);
+  CHECK(*b.lower_bound_left(2.6) == 2.75);
+  CHECK(*b.upper_bound_left(2.5) == 2.75);
+  CHECK(b.upper_bound_left(24.75) == b.end_left());
+  CHECK(*b.lower_bound_right(-1) == 0);
+  CHECK(*b.upper_bound_right(7) == 8);
+  CHECK(b.at_left(12.25) == 98);
+  CHECK(b.at_right(98) == 12.25);
+  CHECK(b.find_left(12.3) == b.end_left());
+  CHECK(b.find_right(99) == b.end_right());
+}
+
 TEST_CASE("Lower bound with non-copyable type") {
   bimap<test_object, test_object> b;
   b.insert(test_object(1), test_object(2));
@@ -437,6 +1192,60 @@ TEST_CASE("Lower bound with non-copyable type") {
   CHECK(b.lower_bound_left(test_object(100)) == b.end_left());
 }
 
+TEST_CASE("Finger search") {
+  bimap<int, std::string> b;
+  CHECK(b.find_left(b.end_left(), 1) == b.end_left());
+  CHECK(b.lower_bound_right(b.end_right(), "1") == b.end_right());
+  for (int i = 0; i < 100; i += 2) {
+    b.insert(i, std::to_string(i));
+  }
+
+  auto from = b.find_left(40);
+  CHECK(*b.find_left(from, 44) == 44);
+  CHECK(*b.find_left(from, 12) == 12);
+  CHECK(b.find_left(from, 45) == b.end_left());
+  CHECK(*b.lower_bound_left(from, 45) == 46);
+  CHECK(*b.lower_bound_left(from, 3) == 4);
+  CHECK(*b.upper_bound_left(from, 40) == 42);
+  CHECK(*b.upper_bound_left(from, -1) == 0);
+  CHECK(b.lower_bound_left(from, 99) == b.end_left());
+  CHECK(*b.lower_bound_left(b.end_left(), 97) == 98);
+  CHECK(*b.lower_bound_left(b.begin_left(), 97) == 98);
+
+  auto right_from = b.find_right("40");
+  CHECK(*b.find_right(right_from, "8") == "8");
+  CHECK(b.find_right(right_from, "9") == b.end_right());
+  CHECK(*b.lower_bound_right(right_from, "9") == "90");
+  CHECK(*b.upper_bound_right(right_from, "") == "0");
+  CHECK(b.upper_bound_right(b.end_right(), "98") == b.end_right());
+}
+
+TEST_CASE("Finger search visits fewer nodes") {
+  size_t calls = 0;
+  bimap<int, int, three_way_comparator, three_way_comparator> b(three_way_comparator{&calls});
+  std::mt19937 e(42);
+  std::vector<int> keys(10'000);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), e);
+  for (int key : keys) {
+    b.insert(key, key);
+  }
+
+  calls = 0;
+  for (int i = 0; i < 10'000; i++) {
+    CHECK(*b.find_left(i) == i);
+  }
+  size_t root_calls = calls;
+
+  calls = 0;
+  auto it = b.begin_left();
+  for (int i = 0; i < 10'000; i++) {
+    it = b.find_left(it, i);
+    CHECK(*it == i);
+  }
+  CHECK(calls * 2 < root_calls);
+}
+
 TEST_CASE("Upper bound") {
   std::vector<std::pair<int, int>> data = {{1, 2}, {2, 3}, {3, 4}, {8, 16}, {32, 66}};
 
@@ -499,6 +1308,38 @@ TEST_CASE("Copy assignment") {
   CHECK(a == b);
 }
 
+TEST_CASE("Copy assignment reuses nodes") {
+  using nothrow_bimap = bimap<int, int, nothrow_state_comparator, nothrow_state_comparator>;
+  nothrow_bimap a(nothrow_state_comparator(true), nothrow_state_comparator(false));
+  a.insert(1, 4);
+  a.insert(8, 8);
+  a.insert(25, 17);
+
+  nothrow_bimap b(nothrow_state_comparator(false), nothrow_state_comparator(true));
+  std::vector<const int*> addresses;
+  for (int i = 0; i < 5; ++i) {
+    b.insert(i, i * 2);
+  }
+  for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+    addresses.push_back(&*it);
+  }
+
+  b = a;
+  CHECK(a == b);
+  CHECK(*b.begin_left() == 25);
+  CHECK(*b.begin_right() == 4);
+  for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+    CHECK(std::find(addresses.begin(), addresses.end(), &*it) != addresses.end());
+  }
+
+  for (int i = 30; i < 40; ++i) {
+    a.insert(i, i);
+  }
+  b = a;
+  CHECK(a == b);
+  CHECK(b.size() == 13);
+}
+
 TEST_CASE("Copy assignment to self") {
   bimap<int, int> a;
   a.insert(1, 4);
@@ -699,6 +1540,175 @@ TEST_CASE("Equivalence with custom comparator") {
   CHECK_FALSE(a != b);
 }
 
+TEST_CASE("Set operations") {
+  bimap<int, std::string> a;
+  a.insert(1, "a");
+  a.insert(2, "b");
+  a.insert(3, "c");
+  a.insert(5, "e");
+  bimap<int, std::string> b;
+  b.insert(0, "z");
+  b.insert(2, "b");
+  b.insert(3, "x");
+  b.insert(4, "e");
+  b.insert(6, "f");
+
+  bimap<int, std::string> expected = a;
+  for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+    expected.insert(*it, *it.flip());
+  }
+  bimap<int, std::string> united = set_union(a, b);
+  CHECK(united == expected);
+  CHECK(united.size() == 6);
+  CHECK(united.at_left(0) == "z");
+  CHECK(united.at_left(3) == "c");
+  CHECK(united.find_left(4) == united.end_left());
+  CHECK(std::equal(united.begin_right(), united.end_right(), expected.begin_right(), expected.end_right()));
+
+  bimap<int, std::string> common = set_intersection(a, b);
+  CHECK(common.size() == 1);
+  CHECK(common.at_left(2) == "b");
+
+  bimap<int, std::string> rest = set_difference(a, b);
+  CHECK(rest.size() == 3);
+  CHECK(rest.at_right("c") == 3);
+  CHECK(rest.find_left(2) == rest.end_left());
+  CHECK(set_union(rest, common) == a);
+
+  bimap<int, std::string> empty;
+  CHECK(set_union(empty, a) == a);
+  CHECK(set_union(a, empty) == a);
+  CHECK(set_intersection(a, empty).empty());
+  CHECK(set_difference(empty, a).empty());
+  CHECK(set_difference(a, a).empty());
+  CHECK(set_intersection(a, a) == a);
+}
+
+TEST_CASE("Set operations take linear time") {
+  size_t calls = 0;
+  using counted_bimap = bimap<int, int, three_way_comparator, three_way_comparator>;
+  counted_bimap a(three_way_comparator{&calls}, three_way_comparator{&calls});
+  counted_bimap b(three_way_comparator{&calls}, three_way_comparator{&calls});
+  for (int i = 0; i < 4000; i++) {
+    if (i % 2 == 0) {
+      a.insert(i, i * 7919 % 4001);
+    }
+    b.insert(i, (i % 4 == 0 ? i : i + 1) * 7919 % 4001);
+  }
+  counted_bimap expected = a;
+  size_t common_size = 0;
+  for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+    expected.insert(*it, *it.flip());
+    common_size += a.find_left(*it) != a.end_left() && a.at_left(*it) == *it.flip();
+  }
+
+  // Both orders are merged in lockstep, so every pair costs a couple of comparisons per order at most,
+  // while sorting either order would take over ten each.
+  calls = 0;
+  counted_bimap united = set_union(a, b);
+  CHECK(calls <= 4 * (a.size() + b.size()));
+  CHECK(united == expected);
+  CHECK(std::equal(united.begin_right(), united.end_right(), expected.begin_right(), expected.end_right()));
+  calls = 0;
+  counted_bimap common = set_intersection(b, a);
+  CHECK(calls <= 4 * (a.size() + b.size()));
+  CHECK(common.size() == common_size);
+  calls = 0;
+  counted_bimap rest = set_difference(b, a);
+  CHECK(calls <= 4 * (a.size() + b.size()));
+  CHECK(rest.size() == b.size() - common_size);
+}
+
+TEST_CASE("Change log") {
+  using versioned_bimap = bimap<int, std::string, std::less<int>, std::less<std::string>, bimap_policy::versioned<4>>;
+  using change = std::tuple<char, int, std::string>;
+  std::vector<change> changes;
+
+  versioned_bimap b;
+  CHECK(b.version() == 0);
+  b.insert(1, "a");
+  b.insert(2, "b");
+  b.insert(3, "c");
+  std::uint64_t seen = b.version();
+  CHECK(seen == 3);
+
+  auto record = [&](std::uint64_t since) {
+    changes.clear();
+    return b.changes_since(
+        since,
+        [&](const int& left, const std::string& right) { changes.emplace_back('-', left, right); },
+        [&](const int& left, const std::string& right) { changes.emplace_back('+', left, right); }
+    );
+  };
+  CHECK(record(seen));
+  CHECK(changes.empty());
+
+  b.erase_left(2);
+  b.insert(4, "d");
+  b.replace_right(b.find_left(1), "z");
+  b.insert(5, "e");
+  b.erase_left(5);
+  CHECK(record(seen));
+  CHECK(changes == std::vector<change>{{'-', 1, "a"}, {'-', 2, "b"}, {'+', 4, "d"}, {'+', 1, "z"}});
+  CHECK(record(0));
+  CHECK(changes == std::vector<change>{{'+', 3, "c"}, {'+', 4, "d"}, {'+', 1, "z"}});
+  CHECK(record(b.version() + 1) == false);
+
+  b.clear();
+  CHECK(record(seen) == false);
+  CHECK(record(b.version()));
+  CHECK(changes.empty());
+
+  versioned_bimap copy;
+  copy.insert(8, "h");
+  seen = b.version();
+  b = copy;
+  CHECK(record(seen) == false);
+  CHECK(record(b.version()));
+  b = std::move(copy);
+  CHECK(record(seen) == false);
+  CHECK(b.size() == 1);
+}
+
+TEST_CASE("Transaction") {
+  bimap<int, std::string> b;
+  b.insert(1, "a");
+  b.insert(2, "b");
+  b.insert(3, "c");
+  bimap<int, std::string> before = b;
+
+  {
+    bimap<int, std::string>::transaction t(b);
+    CHECK(t.insert(4, "d") != b.end_left());
+    CHECK(t.insert(5, "a") == b.end_left());
+    CHECK(t.erase_left(1));
+    CHECK_FALSE(t.erase_left(1));
+    CHECK(t.insert(1, "z") != b.end_left());
+    CHECK(*t.erase_right(b.find_right("b")) == "c");
+    CHECK(t.replace_left(b.find_right("c"), 4) == b.end_left());
+    CHECK(*t.replace_left(b.find_right("c"), 6).flip() == "c");
+    CHECK(b.size() == 3);
+    CHECK(b.at_right("z") == 1);
+    CHECK(b.at_left(6) == "c");
+  }
+  CHECK(b == before);
+  CHECK(std::equal(b.begin_right(), b.end_right(), before.begin_right(), before.end_right()));
+
+  bimap<int, std::string>::transaction t(b);
+  t.erase_left(2);
+  t.replace_right(b.find_left(1), "y");
+  t.insert(2, "x");
+  t.commit();
+  t.rollback();
+  CHECK(b.size() == 3);
+  CHECK(b.at_left(1) == "y");
+  CHECK(b.at_right("x") == 2);
+
+  t.erase_left(3);
+  t.rollback();
+  CHECK(b.at_left(3) == "c");
+}
+
 TEST_CASE("Iterator traits") {
   using bm = bimap<int, double>;
   STATIC_CHECK(std::bidirectional_iterator<bm::left_iterator>);
@@ -0,0 +1,242 @@
+#include "durable-bimap.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+class temporary_directory {
+public:
+  temporary_directory() {
+    std::random_device device;
+    path = fs::temp_directory_path() / ("durable-bimap-test-" + std::to_string(device()));
+    fs::create_directories(path);
+  }
+
+  temporary_directory(const temporary_directory&) = delete;
+  temporary_directory& operator=(const temporary_directory&) = delete;
+
+  ~temporary_directory() {
+    std::error_code ignored;
+    fs::remove_all(path, ignored);
+  }
+
+  fs::path path;
+};
+
+// What would be left on the disk if the process died now: copies of the files as they are.
+void save_crash_image(const fs::path& log, const fs::path& to) {
+  fs::copy_file(log, to, fs::copy_options::overwrite_existing);
+  fs::path snapshot = fs::path(log) += ".snapshot";
+  if (fs::exists(snapshot)) {
+    fs::copy_file(snapshot, fs::path(to) += ".snapshot", fs::copy_options::overwrite_existing);
+  }
+}
+
+using string_bimap = durable_bimap<int, std::string>;
+
+// Trivially copyable, but without a default constructor to decode into.
+struct point {
+  point(int x, int y)
+      : x(x)
+      , y(y) {}
+
+  auto operator<=>(const point&) const = default;
+
+  int x;
+  int y;
+};
+
+} // namespace
+
+TEST_CASE("Durable bimap recovers synced changes") {
+  temporary_directory dir;
+  fs::path path = dir.path / "pairs";
+  {
+    string_bimap b(path);
+    CHECK(b.view().empty());
+    b.insert(1, "a");
+    b.insert(2, "b");
+    b.insert(3, "c");
+    CHECK(b.insert(4, "a") == b.view().end_left());
+    CHECK(b.erase_left(2));
+    CHECK_FALSE(b.erase_right("b"));
+    b.replace_right(b.view().find_left(1), "z");
+    b.replace_left(b.view().find_right("c"), 5);
+    CHECK(b.unsynced() == 6);
+    b.sync();
+    CHECK(b.unsynced() == 0);
+  }
+
+  string_bimap b(path);
+  CHECK(b.view().size() == 2);
+  CHECK(b.view().at_left(1) == "z");
+  CHECK(b.view().at_right("c") == 5);
+}
+
+TEST_CASE("Durable bimap loses only unsynced changes") {
+  temporary_directory dir;
+  fs::path path = dir.path / "pairs";
+  fs::path image = dir.path / "image";
+  {
+    string_bimap b(path, {.sync_every = 3});
+    b.insert(1, "a");
+    b.insert(2, "b");
+    b.insert(3, "c");
+    CHECK(b.unsynced() == 0);
+    b.insert(4, "d");
+    b.clear();
+    save_crash_image(path, image);
+  }
+
+  string_bimap crashed(image);
+  CHECK(crashed.view().size() == 3);
+  string_bimap closed(path);
+  CHECK(closed.view().empty());
+}
+
+TEST_CASE("Durable bimap stores keys without a default constructor") {
+  temporary_directory dir;
+  fs::path path = dir.path / "pairs";
+  {
+    durable_bimap<point, int> b(path);
+    b.insert(point(1, 2), 3);
+    b.checkpoint();
+    b.insert(point(4, 5), 6);
+    b.replace_left(b.view().find_right(3), point(7, 8));
+  }
+
+  durable_bimap<point, int> b(path);
+  CHECK(b.view().size() == 2);
+  CHECK(b.view().at_right(3) == point(7, 8));
+  CHECK(b.view().at_left(point(4, 5)) == 6);
+}
+
+TEST_CASE("Durable bimap drops a torn record") {
+  temporary_directory dir;
+  fs::path path = dir.path / "pairs";
+  {
+    string_bimap b(path);
+    b.insert(1, "a");
+    b.insert(2, "b");
+  }
+  auto size = fs::file_size(path);
+  fs::resize_file(path, size - 1);
+  {
+    std::ofstream(path, std::ios::binary | std::ios::app) << "garbage";
+    string_bimap b(path);
+    CHECK(b.view().size() == 1);
+    b.insert(3, "c");
+  }
+
+  string_bimap b(path);
+  CHECK(b.view().size() == 2);
+  CHECK(b.view().at_left(3) == "c");
+}
+
+TEST_CASE("Durable bimap checkpoints") {
+  temporary_directory dir;
+  fs::path path = dir.path / "pairs";
+  fs::path image = dir.path / "image";
+  durable_bimap<int, int> b(path, {.sync_every = 16, .checkpoint_every = 64});
+  std::mt19937 e(std::mt19937::default_seed);
+  for (int i = 0; i < 1'000; i++) {
+    if (e() % 3 == 0) {
+      b.erase_left(e() % 300);
+    } else {
+      b.insert(e() % 300, e() % 300);
+    }
+    if (i == 500) {
+      fs::copy_file(path, image);
+    }
+  }
+  b.sync();
+  CHECK(fs::exists(fs::path(path) += ".snapshot"));
+  {
+    durable_bimap<int, int> recovered(path);
+    CHECK(recovered.view() == b.view());
+  }
+
+  // A log from before the last checkpoint is not replayed over the snapshot that includes it.
+  b.checkpoint();
+  CHECK(fs::file_size(path) == 16);
+  fs::copy_file(image, path, fs::copy_options::overwrite_existing);
+  durable_bimap<int, int> recovered(path);
+  CHECK(recovered.view() == b.view());
+}
+
+TEST_CASE("Durable bimap checkpoints unsynced changes") {
+  temporary_directory dir;
+  fs::path path = dir.path / "pairs";
+  {
+    string_bimap b(path);
+    b.insert(1, "a");
+    b.checkpoint();
+    CHECK(b.unsynced() == 0);
+    b.insert(2, "b");
+  }
+
+  string_bimap b(path);
+  CHECK(b.view().size() == 2);
+}
+
+TEST_CASE("Durable bimap starts a log only where there is none") {
+  temporary_directory dir;
+  fs::path path = dir.path / "pairs";
+  std::ofstream(path, std::ios::binary);
+  {
+    string_bimap b(path);
+    b.insert(1, "a");
+  }
+  fs::resize_file(path, 5);
+  {
+    string_bimap b(path);
+    CHECK(b.view().empty());
+  }
+
+  std::ofstream(path, std::ios::binary) << "not a log, but long enough to look like one";
+  CHECK_THROWS_AS(string_bimap(path), std::runtime_error);
+  CHECK(fs::file_size(path) > 16);
+}
+
+TEST_CASE("Durable bimap rejects a log newer than the snapshot") {
+  temporary_directory dir;
+  fs::path path = dir.path / "pairs";
+  {
+    string_bimap b(path);
+    b.insert(1, "a");
+    b.checkpoint();
+    b.insert(2, "b");
+  }
+  fs::remove(fs::path(path) += ".snapshot");
+  CHECK_THROWS_AS(string_bimap(path), std::runtime_error);
+}
+
+TEST_CASE("Durable bimap rejects a record that does not apply") {
+  temporary_directory dir;
+  fs::path path = dir.path / "pairs";
+  fs::path other = dir.path / "other";
+  {
+    string_bimap b(other);
+    b.insert(1, "a");
+    b.checkpoint();
+    b.replace_right(b.view().find_left(1), "z");
+    b.insert(2, "b");
+  }
+  {
+    string_bimap b(path);
+    b.insert(3, "c");
+    b.checkpoint();
+  }
+  // The replace in the other log has no pair to apply to here, and the records after it must not be dropped.
+  fs::copy_file(other, path, fs::copy_options::overwrite_existing);
+  CHECK_THROWS_AS(string_bimap(path), std::runtime_error);
+  CHECK(fs::file_size(path) == fs::file_size(other));
+}
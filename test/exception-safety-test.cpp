@@ -5,7 +5,9 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include <algorithm>
+#include <memory>
 #include <random>
+#include <vector>
 
 namespace {
 
@@ -44,6 +46,26 @@ private:
   int value;
 };
 
+// Can only be moved, and the move may throw.
+class movable_element {
+public:
+  movable_element(int data = 0)
+      : value(data) {}
+
+  movable_element(movable_element&& other)
+      : value(other.value) {
+    fault_injection_point();
+    other.value = -1;
+  }
+
+  movable_element& operator=(movable_element&& other) = delete;
+
+  friend bool operator==(const movable_element& lhs, const movable_element& rhs) = default;
+  friend auto operator<=>(const movable_element& lhs, const movable_element& rhs) = default;
+
+  int value;
+};
+
 template <typename... Ts>
 class snapshot {
 public:
@@ -60,19 +82,19 @@ private:
   std::tuple<snapshot<Ts>...> snapshots;
 };
 
-template <>
-class snapshot<bimap<element, element>> {
+template <typename... Params>
+class snapshot<bimap<Params...>> {
 public:
-  explicit snapshot(const bimap<element, element>& b)
+  explicit snapshot(const bimap<Params...>& b)
       : bimap_snapshot(b) {}
 
   snapshot(const snapshot&) = delete;
 
-  void verify(const bimap<element, element>& other) const {
+  void verify(const bimap<Params...>& other) const {
     REQUIRE(other == bimap_snapshot);
   }
 
-  bimap<element, element> bimap_snapshot;
+  bimap<Params...> bimap_snapshot;
 };
 
 template <typename F, typename... Ts>
@@ -95,6 +117,37 @@ void strong_exception_safety(F f, const Ts&... objects) {
   }
 }
 
+template <typename Policy>
+void check_replace_keeps_move_only_key() {
+  faulty_run([] {
+    bimap<std::unique_ptr<int>, movable_element, std::less<>, std::less<>, Policy> a;
+    std::vector<const int*> lefts;
+    {
+      fault_injection_disable dg;
+      for (int i = 0; i < 3; ++i) {
+        auto left = std::make_unique<int>(i);
+        lefts.push_back(left.get());
+        a.insert(std::move(left), 2 * i);
+      }
+    }
+
+    try {
+      a.replace_right(a.find_right(2).flip(), 7);
+    } catch (...) {
+      fault_injection_disable dg;
+      REQUIRE(a.size() == 3);
+      for (int i = 0; i < 3; ++i) {
+        auto it = a.find_right(2 * i);
+        REQUIRE(it != a.end_right());
+        REQUIRE(it.flip()->get() == lefts[i]);
+      }
+      throw;
+    }
+    fault_injection_disable dg;
+    REQUIRE(a.find_right(7).flip()->get() == lefts[1]);
+  });
+}
+
 } // namespace
 
 TEST_CASE("Default constructor does not throw") {
@@ -112,6 +165,62 @@ TEST_CASE("Insert is exception-safe") {
   });
 }
 
+TEST_CASE("Emplace is exception-safe") {
+  faulty_run([] {
+    bimap<element, element> a;
+    {
+      fault_injection_disable dg;
+      a.insert(1, 2);
+      a.insert(3, 4);
+    }
+    strong_exception_safety(
+        [&a] { a.emplace(std::piecewise_construct, std::forward_as_tuple(5), std::forward_as_tuple(6)); },
+        a
+    );
+    strong_exception_safety(
+        [&a] { a.emplace(std::piecewise_construct, std::forward_as_tuple(3), std::forward_as_tuple(7)); },
+        a
+    );
+    strong_exception_safety([&a] { a.try_emplace_left(7, 8); }, a);
+    strong_exception_safety([&a] { a.try_emplace_right(8, 9); }, a);
+  });
+}
+
+TEST_CASE("Insert range is exception-safe") {
+  faulty_run([] {
+    bimap<element, element> a;
+    {
+      fault_injection_disable dg;
+      a.insert(1, 2);
+      a.insert(3, 4);
+    }
+    std::pair<int, int> batch[] = {{5, 6}, {3, 7}, {8, 2}, {9, 10}, {5, 11}};
+    strong_exception_safety([&] { a.insert_range(std::begin(batch), std::end(batch)); }, a);
+  });
+}
+
+TEST_CASE("Insert into compact bimap is exception-safe") {
+  faulty_run([] {
+    bimap<element, element, std::less<element>, std::less<element>, bimap_policy::compact> b;
+    {
+      fault_injection_disable dg;
+      for (int i = 0; i < 4; i++) {
+        b.insert(i, -i);
+      }
+    }
+
+    strong_exception_safety([&b] { b.insert(10, 10); }, b);
+    strong_exception_safety(
+        [&b] { b.emplace(std::piecewise_construct, std::forward_as_tuple(11), std::forward_as_tuple(11)); },
+        b
+    );
+    std::pair<int, int> batch[] = {{1, 12}, {12, 12}, {13, -3}, {14, 14}, {12, 15}, {15, 16}, {16, 17}};
+    strong_exception_safety([&] { b.insert_range(std::begin(batch), std::end(batch)); }, b);
+    strong_exception_safety([&b] { b.erase_left(2); }, b);
+    strong_exception_safety([&b] { b.replace_left(b.find_right(-1), 20); }, b);
+  });
+}
+
 TEST_CASE("Copy constructor is exception-safe") {
   faulty_run([] {
     bimap<element, element> a;
@@ -167,6 +276,24 @@ TEST_CASE("Copy assignment to non-empty is exception-safe") {
   });
 }
 
+TEST_CASE("Copy assignment reusing nodes is exception-safe") {
+  faulty_run([] {
+    bimap<int, int> a;
+    bimap<int, int> b;
+    {
+      fault_injection_disable dg;
+      for (int i = 0; i < 7; ++i) {
+        a.insert(i, 10 - i);
+      }
+      b.insert(1, 4);
+      b.insert(8, 8);
+      b.insert(25, 17);
+    }
+
+    strong_exception_safety([&a, &b] { b = a; }, a, b);
+  });
+}
+
 TEST_CASE("Move constructor does not throw") {
   assert_nothrow([] {
     bimap<element, element> a;
@@ -183,6 +310,58 @@ TEST_CASE("Move constructor does not throw") {
   });
 }
 
+TEST_CASE("Small bimap does not allocate") {
+  using small_bimap = bimap<int, int, std::less<int>, std::less<int>, bimap_policy::small<4>>;
+  assert_nothrow([] {
+    small_bimap a;
+    for (int i = 0; i < 4; i++) {
+      a.insert(i, -i);
+    }
+    a.erase_left(2);
+    a.insert(5, 5);
+
+    small_bimap b = std::move(a);
+    small_bimap c;
+    c.insert(10, 10);
+    swap(b, c);
+    c = b;
+  });
+}
+
+TEST_CASE("Insert after reserve does not allocate") {
+  bimap<int, int> a;
+  a.insert(0, 0);
+  a.reserve(10);
+  bimap<int, int, std::less<int>, std::less<int>, bimap_policy::small<4>> b;
+  b.reserve(10);
+  assert_nothrow([&] {
+    for (int i = 1; i <= 10; i++) {
+      a.insert(i, -i);
+      b.insert(i, -i);
+    }
+  });
+}
+
+TEST_CASE("Copy assignment into reserved bimap is exception-safe") {
+  faulty_run([] {
+    bimap<int, int> a;
+    bimap<int, int> b;
+    {
+      fault_injection_disable dg;
+      for (int i = 0; i < 9; ++i) {
+        a.insert(i, 10 - i);
+      }
+      b.reserve(3);
+      b.insert(1, 4);
+      b.insert(8, 8);
+    }
+
+    strong_exception_safety([&a, &b] { b = a; }, a, b);
+    fault_injection_disable dg;
+    REQUIRE(b.capacity() == 10);
+  });
+}
+
 TEST_CASE("Move assignment does not throw") {
   assert_nothrow([] {
     bimap<element, element> a;
@@ -279,6 +458,28 @@ TEST_CASE("At-or-default is exception-safe") {
   });
 }
 
+TEST_CASE("Replace is exception-safe") {
+  faulty_run([] {
+    bimap<element, element> a;
+    {
+      fault_injection_disable dg;
+      a.insert(1, 2);
+      a.insert(3, 4);
+      a.insert(5, 6);
+    }
+
+    strong_exception_safety([&a] { a.replace_left(a.find_right(4), 7); }, a);
+    strong_exception_safety([&a] { a.replace_right(a.find_left(1), 0); }, a);
+    strong_exception_safety([&a] { a.replace_left(a.find_right(6), 5); }, a);
+    strong_exception_safety([&a] { a.replace_right(a.find_left(5), 4); }, a);
+  });
+}
+
+TEST_CASE("Replace keeps a move-only opposite key if the new key throws") {
+  check_replace_keeps_move_only_key<bimap_policy::standard>();
+  check_replace_keeps_move_only_key<bimap_policy::split>();
+}
+
 TEST_CASE("insert with move semantics provides strong exception guarantee") {
   int counter = 0;
   using Bimap = bimap<counter_moved, counter_moved, expiring_comparator, expiring_comparator>;
@@ -295,3 +496,45 @@ TEST_CASE("insert with move semantics provides strong exception guarantee") {
   REQUIRE_THROWS(a.insert(counter_moved(3, &counter), counter_moved(4, &counter)));
   REQUIRE(counter == 0);
 }
+
+TEST_CASE("Set operations are exception-safe") {
+  faulty_run([] {
+    bimap<element, element> a, b;
+    {
+      fault_injection_disable dg;
+      a.insert(1, 2);
+      a.insert(3, 4);
+      a.insert(5, 6);
+      b.insert(3, 4);
+      b.insert(7, 6);
+      b.insert(8, 9);
+    }
+    strong_exception_safety([&] { set_union(a, b); }, a);
+    strong_exception_safety([&] { set_intersection(a, b); }, b);
+    strong_exception_safety([&] { set_difference(b, a); }, a);
+  });
+}
+
+TEST_CASE("Transaction is all or nothing") {
+  faulty_run([] {
+    bimap<element, element> a;
+    {
+      fault_injection_disable dg;
+      a.insert(1, 2);
+      a.insert(3, 4);
+      a.insert(5, 6);
+    }
+    strong_exception_safety(
+        [&a] {
+          bimap<element, element>::transaction t(a);
+          t.insert(7, 8);
+          t.erase_left(1);
+          t.replace_right(a.find_left(3), 9);
+          t.insert(1, 4);
+          t.erase_right(a.find_right(6));
+          t.commit();
+        },
+        a
+    );
+  });
+}
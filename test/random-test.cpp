@@ -4,8 +4,10 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include <algorithm>
+#include <execution>
 #include <map>
 #include <random>
+#include <vector>
 
 namespace {
 
@@ -36,6 +38,396 @@ std::vector<std::pair<T, T>> eliminate_same(std::vector<T>& lefts, std::vector<T
 
 static constexpr uint32_t seed = 1488228;
 
+namespace {
+
+struct split_threaded : bimap_policy::split {
+  static constexpr bool threads = true;
+};
+
+struct split_compact : bimap_policy::split {
+  static constexpr bool compact_links = true;
+};
+
+struct splay_threaded : bimap_policy::splay {
+  static constexpr bool threads = true;
+};
+
+struct splay_compact : bimap_policy::splay {
+  static constexpr bool compact_links = true;
+};
+
+struct versioned_split : bimap_policy::versioned<8> {
+  static constexpr bool split_halves = true;
+};
+
+// Mixes inserts, erasures and replacements and checks both orders in both directions against two maps.
+template <typename Policy>
+void check_policy_against_maps() {
+  bimap<int, int, std::less<int>, std::less<int>, Policy> b;
+  std::map<int, int> left_view, right_view;
+
+  std::mt19937 e(seed);
+  for (size_t round = 0; round < 300; round++) {
+    for (size_t i = 0; i < 300; i++) {
+      int l = e() % 10'000, r = e() % 10'000;
+      switch (e() % 4) {
+      case 0:
+      case 1:
+        if (auto it = b.insert(l, r); it != b.end_left()) {
+          left_view.insert({l, r});
+          right_view.insert({r, l});
+        }
+        break;
+      case 2:
+        if (b.erase_left(l)) {
+          right_view.erase(left_view.at(l));
+          left_view.erase(l);
+        }
+        break;
+      default:
+        if (auto it = b.find_right(r); it != b.end_right() && b.find_left(l) == b.end_left()) {
+          b.replace_left(it, l);
+          left_view.erase(right_view.at(r));
+          left_view.insert({l, r});
+          right_view[r] = l;
+        }
+        break;
+      }
+    }
+
+    int a = e() % 10'000, c = a + e() % 500;
+    if (round % 3 == 0) {
+      b.erase_left(b.lower_bound_left(a), b.lower_bound_left(c));
+      for (auto mit = left_view.lower_bound(a); mit != left_view.lower_bound(c);) {
+        right_view.erase(mit->second);
+        mit = left_view.erase(mit);
+      }
+    } else if (round % 3 == 1 && !b.empty()) {
+      b.erase_right(b.lower_bound_right(a), b.end_right());
+      for (auto mit = right_view.lower_bound(a); mit != right_view.end();) {
+        left_view.erase(mit->second);
+        mit = right_view.erase(mit);
+      }
+    }
+
+    REQUIRE(b.size() == left_view.size());
+    auto lit = b.begin_left();
+    for (auto mit = left_view.begin(); mit != left_view.end(); ++mit, ++lit) {
+      REQUIRE(*lit == mit->first);
+      REQUIRE(*lit.flip() == mit->second);
+    }
+    REQUIRE(lit == b.end_left());
+    auto rit = b.end_right();
+    for (auto mit = right_view.rbegin(); mit != right_view.rend(); ++mit) {
+      --rit;
+      REQUIRE(*rit == mit->first);
+      REQUIRE(*rit.flip() == mit->second);
+    }
+    REQUIRE(rit == b.begin_right());
+  }
+}
+
+// Applies random batches with conflicts both within them and with the existing keys, and compares with `insert`.
+template <typename Policy>
+void check_insert_range_against_insert() {
+  using policy_bimap = bimap<int, int, std::less<int>, std::less<int>, Policy>;
+  policy_bimap b, expected;
+
+  std::mt19937 e(seed);
+  for (size_t round = 0; round < 40; round++) {
+    size_t size = round % 4 == 0 ? e() % 4 : e() % 3'000;
+    int range = static_cast<int>(e() % 20'000) + 10;
+    std::vector<std::pair<int, int>> batch(size);
+    for (auto& [l, r] : batch) {
+      l = e() % range;
+      r = e() % range;
+    }
+    size_t inserted = 0;
+    for (auto& [l, r] : batch) {
+      if (auto it = expected.insert(l, r); it != expected.end_left()) {
+        ++inserted;
+      }
+    }
+    REQUIRE(b.insert_range(batch.begin(), batch.end()) == inserted);
+    REQUIRE(b == expected);
+    REQUIRE(std::equal(b.begin_right(), b.end_right(), expected.begin_right(), expected.end_right()));
+    REQUIRE(std::equal(
+        std::make_reverse_iterator(b.end_left()),
+        std::make_reverse_iterator(b.begin_left()),
+        std::make_reverse_iterator(expected.end_left()),
+        std::make_reverse_iterator(expected.begin_left())
+    ));
+    if (round % 10 == 9) {
+      b.erase_left(b.begin_left(), b.lower_bound_left(range / 2));
+      expected.erase_left(expected.begin_left(), expected.lower_bound_left(range / 2));
+    }
+  }
+}
+
+// Builds bimaps from random batches with a parallel policy and compares them with `insert`.
+template <typename Policy>
+void check_parallel_build_against_insert() {
+  using policy_bimap = bimap<int, int, std::less<int>, std::less<int>, Policy>;
+
+  std::mt19937 e(seed);
+  for (size_t round = 0; round < 10; round++) {
+    int range = static_cast<int>(e() % 40'000) + 10;
+    std::vector<std::pair<int, int>> batch(e() % 20'000);
+    std::vector<int> rights(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+      batch[i] = {static_cast<int>(e() % range), static_cast<int>(e() % range)};
+      rights[i] = batch[i].second;
+    }
+    policy_bimap expected;
+    for (auto& [l, r] : batch) {
+      expected.insert(l, r);
+    }
+    policy_bimap b(std::execution::par, batch.begin(), batch.end());
+    REQUIRE(b == expected);
+    REQUIRE(std::equal(b.begin_right(), b.end_right(), expected.begin_right(), expected.end_right()));
+
+    std::vector<typename policy_bimap::right_iterator> found(rights.size());
+    b.find_right(std::execution::par, rights.begin(), rights.end(), found.begin());
+    for (size_t i = 0; i < rights.size(); i++) {
+      REQUIRE(found[i] == b.find_right(rights[i]));
+    }
+  }
+}
+
+// Compares the set operations with their definitions in terms of `insert` and `find`.
+template <typename Policy>
+void check_set_operations() {
+  using policy_bimap = bimap<int, int, std::less<int>, std::less<int>, Policy>;
+
+  std::mt19937 e(seed);
+  for (size_t round = 0; round < 20; round++) {
+    int range = static_cast<int>(e() % 5'000) + 10;
+    policy_bimap a, b;
+    for (size_t i = e() % 3'000; i > 0; i--) {
+      a.insert(e() % range, e() % range);
+    }
+    for (size_t i = e() % 3'000; i > 0; i--) {
+      b.insert(e() % range, e() % range);
+      if (e() % 4 == 0 && !a.empty()) {
+        auto it = a.lower_bound_left(e() % range);
+        if (it != a.end_left()) {
+          b.insert(*it, *it.flip());
+        }
+      }
+    }
+
+    policy_bimap united = a, common, rest;
+    for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+      united.insert(*it, *it.flip());
+    }
+    for (auto it = a.begin_left(); it != a.end_left(); ++it) {
+      auto found = b.find_left(*it);
+      if (found != b.end_left() && *found.flip() == *it.flip()) {
+        common.insert(*it, *it.flip());
+      } else {
+        rest.insert(*it, *it.flip());
+      }
+    }
+
+    for (auto& [result, expected] : {std::pair(set_union(a, b), united),
+                                     std::pair(set_intersection(a, b), common),
+                                     std::pair(set_difference(a, b), rest)}) {
+      REQUIRE(result == expected);
+      REQUIRE(std::equal(result.begin_right(), result.end_right(), expected.begin_right(), expected.end_right()));
+      auto rit = result.end_right();
+      for (auto it = expected.end_right(); it != expected.begin_right();) {
+        REQUIRE(*--rit == *--it);
+      }
+    }
+  }
+}
+
+// Keeps a plain copy of a bimap with a change log up to date through `changes_since`.
+template <typename Policy>
+void check_change_log() {
+  bimap<int, int, std::less<int>, std::less<int>, Policy> b;
+  bimap<int, int> follower;
+  std::uint64_t seen = b.version();
+  size_t resyncs = 0;
+
+  std::mt19937 e(seed);
+  for (size_t round = 0; round < 4'000; round++) {
+    int a = e() % 1'000, c = e() % 1'000;
+    switch (e() % 8) {
+    case 0:
+    case 1:
+    case 2:
+      b.insert(a, c);
+      break;
+    case 3:
+      b.erase_left(a);
+      break;
+    case 4:
+      b.erase_right(b.lower_bound_right(std::min(a, c)), b.lower_bound_right(std::min(a, c) + e() % 20));
+      break;
+    case 5:
+      if (auto it = b.lower_bound_left(a); it != b.end_left()) {
+        b.replace_right(it, c);
+      }
+      break;
+    case 6:
+      if (e() % 50 == 0) {
+        b.clear();
+      }
+      break;
+    default:
+      std::pair<int, int> batch[] = {{a, c}, {c, a}, {a + 1, c + 1}};
+      b.insert_range(std::begin(batch), std::end(batch));
+    }
+
+    if (e() % 10 == 0) {
+      bool in_log = b.changes_since(
+          seen,
+          [&](int left, int right) {
+            REQUIRE(follower.at_left(left) == right);
+            follower.erase_left(left);
+          },
+          [&](int left, int right) { REQUIRE(follower.insert(left, right) != follower.end_left()); }
+      );
+      if (!in_log) {
+        ++resyncs;
+        follower.clear();
+        for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+          follower.insert(*it, *it.flip());
+        }
+      }
+      seen = b.version();
+      REQUIRE(follower.size() == b.size());
+      REQUIRE(std::equal(follower.begin_left(), follower.end_left(), b.begin_left(), b.end_left()));
+      REQUIRE(std::equal(follower.begin_right(), follower.end_right(), b.begin_right(), b.end_right()));
+    }
+  }
+  REQUIRE(resyncs < 400);
+}
+
+// Runs random transactions, committing some and rolling back the rest, and compares with a copy.
+template <typename Policy>
+void check_transactions() {
+  using policy_bimap = bimap<int, int, std::less<int>, std::less<int>, Policy>;
+  policy_bimap b;
+
+  std::mt19937 e(seed);
+  for (size_t round = 0; round < 300; round++) {
+    policy_bimap expected = b;
+    bool commit = e() % 2 == 0;
+    {
+      typename policy_bimap::transaction t(b);
+      for (size_t i = e() % 60; i > 0; i--) {
+        int a = e() % 500, c = e() % 500;
+        switch (e() % 5) {
+        case 0:
+        case 1:
+          t.insert(a, c);
+          break;
+        case 2:
+          t.erase_right(c);
+          break;
+        case 3:
+          if (auto it = b.lower_bound_left(a); it != b.end_left()) {
+            t.erase_left(it);
+          }
+          break;
+        default:
+          if (auto it = b.lower_bound_right(a); it != b.end_right()) {
+            t.replace_left(it, c);
+          }
+        }
+      }
+      if (commit) {
+        expected = b;
+        t.commit();
+      }
+    }
+    REQUIRE(b == expected);
+    REQUIRE(std::equal(b.begin_right(), b.end_right(), expected.begin_right(), expected.end_right()));
+    REQUIRE(std::equal(
+        std::make_reverse_iterator(b.end_left()),
+        std::make_reverse_iterator(b.begin_left()),
+        std::make_reverse_iterator(expected.end_left()),
+        std::make_reverse_iterator(expected.begin_left())
+    ));
+  }
+}
+
+template <typename Policy>
+void check_finger_search_against_map() {
+  bimap<int, int, std::less<int>, std::less<int>, Policy> b;
+  std::map<int, int> left_view;
+
+  std::mt19937 e(seed);
+  for (size_t i = 0; i < 5'000; i++) {
+    int l = e() % 20'000, r = e() % 20'000;
+    if (b.insert(l, r) != b.end_left()) {
+      left_view.insert({l, r});
+    }
+  }
+
+  auto from = b.begin_left();
+  for (size_t i = 0; i < 100'000; i++) {
+    int key = e() % 2 == 0 ? e() % 20'002 - 1 : (from == b.end_left() ? 0 : *from) + static_cast<int>(e() % 41) - 20;
+    auto expected = left_view.lower_bound(key);
+    auto lower = b.lower_bound_left(from, key);
+    if (expected == left_view.end()) {
+      REQUIRE(lower == b.end_left());
+    } else {
+      REQUIRE(lower != b.end_left());
+      REQUIRE(*lower == expected->first);
+    }
+    REQUIRE(b.upper_bound_left(from, key) == b.upper_bound_left(key));
+    REQUIRE(b.find_left(from, key) == b.find_left(key));
+    REQUIRE(b.lower_bound_right(from.flip(), key) == b.lower_bound_right(key));
+    from = e() % 8 == 0 ? b.end_left() : lower;
+  }
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+// For the coroutine below, as in bimap.h.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+
+template <typename Policy>
+void check_async_lookups(std::size_t pairs) {
+  bimap<int, int, std::less<int>, std::less<int>, Policy> b;
+  std::mt19937 e(seed);
+  for (size_t i = 0; i < pairs; i++) {
+    b.insert(e() % (2 * pairs), e() % (2 * pairs));
+  }
+
+  std::vector<int> keys(2'000);
+  for (int& key : keys) {
+    key = static_cast<int>(e() % (2 * pairs + 2)) - 1;
+  }
+  std::size_t checked = 0;
+  lookup_scheduler scheduler;
+  for (std::size_t t = 0; t < 64; t++) {
+    scheduler.spawn([](const auto& map, const std::vector<int>& queries, std::size_t first, std::size_t& done)
+                        -> lookup_scheduler::task {
+      for (std::size_t i = first; i < queries.size(); i += 64) {
+        auto left = co_await map.find_left_async(queries[i]);
+        REQUIRE(left == map.find_left(queries[i]));
+        auto right = co_await map.find_right_async(queries[i]);
+        REQUIRE(right == map.find_right(queries[i]));
+        ++done;
+      }
+    }(b, keys, t, checked));
+  }
+  scheduler.run();
+  REQUIRE(checked == keys.size());
+  REQUIRE(scheduler.size() == 0);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic pop
+#endif
+
+} // namespace
+
 TEST_CASE("[Randomized] - Comparison") {
   INFO("Seed used for randomized compare test is " << seed);
 
@@ -150,3 +542,617 @@ TEST_CASE("[Randomized] - Compare to 2 maps") {
   INFO("Comparing to maps stat:");
   INFO("Performed " << ins << " insertions and " << total - ins - skip << " erasures. " << skip << " skipped.");
 }
+
+TEST_CASE("[Randomized] - Erase ranges") {
+  INFO("Seed used for randomized range erase test is " << seed);
+
+  bimap<int, int> b;
+  std::map<int, int> left_view, right_view;
+
+  std::mt19937 e(seed);
+  for (size_t round = 0; round < 200; round++) {
+    while (b.size() < 1000) {
+      int l = e() % 100'000, r = e() % 100'000;
+      if (b.insert(l, r) != b.end_left()) {
+        left_view.insert({l, r});
+        right_view.insert({r, l});
+      }
+    }
+
+    int a = e() % 100'000, c = e() % 100'000;
+    if (round % 5 == 0) {
+      a = -1;
+    }
+    if (a > c) {
+      std::swap(a, c);
+    }
+    if (round % 2 == 0) {
+      auto it = b.erase_left(b.lower_bound_left(a), b.lower_bound_left(c));
+      CHECK(it == b.lower_bound_left(c));
+      for (auto mit = left_view.lower_bound(a); mit != left_view.lower_bound(c);) {
+        right_view.erase(mit->second);
+        mit = left_view.erase(mit);
+      }
+    } else {
+      auto it = b.erase_right(b.lower_bound_right(a), b.lower_bound_right(c));
+      CHECK(it == b.lower_bound_right(c));
+      for (auto mit = right_view.lower_bound(a); mit != right_view.lower_bound(c);) {
+        left_view.erase(mit->second);
+        mit = right_view.erase(mit);
+      }
+    }
+
+    REQUIRE(b.size() == left_view.size());
+    auto lit = b.begin_left();
+    for (auto mit = left_view.begin(); mit != left_view.end(); ++mit, ++lit) {
+      REQUIRE(*lit == mit->first);
+      REQUIRE(*lit.flip() == mit->second);
+    }
+    REQUIRE(lit == b.end_left());
+    auto rit = b.begin_right();
+    for (auto mit = right_view.begin(); mit != right_view.end(); ++mit, ++rit) {
+      REQUIRE(*rit == mit->first);
+      REQUIRE(*rit.flip() == mit->second);
+    }
+    REQUIRE(rit == b.end_right());
+  }
+}
+
+TEST_CASE("[Randomized] - Insert range") {
+  INFO("Seed used for randomized insert range test is " << seed);
+  check_insert_range_against_insert<bimap_policy::standard>();
+  check_insert_range_against_insert<bimap_policy::threaded>();
+  check_insert_range_against_insert<bimap_policy::compact>();
+  check_insert_range_against_insert<bimap_policy::split>();
+  check_insert_range_against_insert<bimap_policy::small<8>>();
+}
+
+TEST_CASE("[Randomized] - Parallel build") {
+  check_parallel_build_against_insert<bimap_policy::standard>();
+  check_parallel_build_against_insert<bimap_policy::compact>();
+  check_parallel_build_against_insert<bimap_policy::split>();
+}
+
+TEST_CASE("[Randomized] - Set operations") {
+  check_set_operations<bimap_policy::standard>();
+  check_set_operations<bimap_policy::threaded>();
+  check_set_operations<bimap_policy::compact>();
+  check_set_operations<bimap_policy::split>();
+  check_set_operations<bimap_policy::small<8>>();
+}
+
+TEST_CASE("[Randomized] - Change log") {
+  check_change_log<bimap_policy::versioned<64>>();
+  check_change_log<versioned_split>();
+}
+
+TEST_CASE("[Randomized] - Transactions") {
+  check_transactions<bimap_policy::standard>();
+  check_transactions<bimap_policy::threaded>();
+  check_transactions<bimap_policy::split>();
+  check_transactions<bimap_policy::splay>();
+  check_transactions<bimap_policy::small<8>>();
+  check_transactions<bimap_policy::versioned<16>>();
+}
+
+TEST_CASE("[Randomized] - Finger search") {
+  INFO("Seed used for randomized finger search test is " << seed);
+  check_finger_search_against_map<bimap_policy::standard>();
+  check_finger_search_against_map<bimap_policy::threaded>();
+  check_finger_search_against_map<bimap_policy::compact>();
+}
+
+TEST_CASE("[Randomized] - Async lookups") {
+  INFO("Seed used for randomized async lookups test is " << seed);
+  check_async_lookups<bimap_policy::standard>(10'000);
+  check_async_lookups<bimap_policy::threaded>(10'000);
+  check_async_lookups<bimap_policy::compact>(10'000);
+  check_async_lookups<bimap_policy::split>(10'000);
+  check_async_lookups<bimap_policy::splay>(10'000);
+  check_async_lookups<bimap_policy::small<8>>(8);
+}
+
+TEST_CASE("[Randomized] - Policies against maps") {
+  INFO("Seed used for randomized policies test is " << seed);
+  check_policy_against_maps<bimap_policy::threaded>();
+  check_policy_against_maps<bimap_policy::compact>();
+  check_policy_against_maps<bimap_policy::split>();
+  check_policy_against_maps<split_threaded>();
+  check_policy_against_maps<split_compact>();
+  check_policy_against_maps<bimap_policy::splay>();
+  check_policy_against_maps<splay_threaded>();
+  check_policy_against_maps<splay_compact>();
+  check_policy_against_maps<bimap_policy::small<8>>();
+}
+
+TEST_CASE("[Randomized] - Threaded steps") {
+  INFO("Seed used for randomized threaded steps test is " << seed);
+
+  using threaded_bimap = bimap<int, int, std::less<int>, std::less<int>, bimap_policy::threaded>;
+  threaded_bimap b;
+  std::map<int, int> left_view, right_view;
+
+  // Every kind of change relinks the threads of the neighbours, so after each one a few steps are taken in both
+  // directions on both sides from a random place, crossing the ends, and compared with the maps.
+  std::mt19937 e(seed);
+  for (size_t i = 0; i < 20'000; i++) {
+    int l = e() % 2'000, r = e() % 2'000;
+    switch (e() % 8) {
+    case 0:
+    case 1:
+    case 2:
+      if (b.insert(l, r) != b.end_left()) {
+        left_view.insert({l, r});
+        right_view.insert({r, l});
+      }
+      break;
+    case 3:
+      if (auto it = b.lower_bound_left(l); it != b.end_left()) {
+        right_view.erase(*it.flip());
+        left_view.erase(*it);
+        b.erase_left(it);
+      }
+      break;
+    case 4:
+      if (auto it = b.lower_bound_right(r); it != b.end_right() && b.find_left(l) == b.end_left()) {
+        left_view.erase(*it.flip());
+        left_view.insert({l, *it});
+        right_view[*it] = l;
+        b.replace_left(it, l);
+      }
+      break;
+    case 5:
+      if (auto it = b.lower_bound_left(l); it != b.end_left() && b.find_right(r) == b.end_right()) {
+        right_view.erase(*it.flip());
+        right_view.insert({r, *it});
+        left_view[*it] = r;
+        b.replace_right(it, r);
+      }
+      break;
+    case 6: {
+      int last = r + static_cast<int>(e() % 40);
+      b.erase_right(b.lower_bound_right(r), b.lower_bound_right(last));
+      for (auto it = right_view.lower_bound(r); it != right_view.lower_bound(last);) {
+        left_view.erase(it->second);
+        it = right_view.erase(it);
+      }
+      break;
+    }
+    default:
+      if (e() % 100 == 0) {
+        b.clear();
+        left_view.clear();
+        right_view.clear();
+      }
+    }
+
+    REQUIRE(b.size() == left_view.size());
+    REQUIRE((b.begin_left() == b.end_left()) == left_view.empty());
+    if (!left_view.empty()) {
+      REQUIRE(*b.begin_left() == left_view.begin()->first);
+      REQUIRE(*b.begin_right() == right_view.begin()->first);
+      REQUIRE(*std::prev(b.end_left()) == left_view.rbegin()->first);
+      REQUIRE(*std::prev(b.end_right()) == right_view.rbegin()->first);
+    }
+    int from = static_cast<int>(e() % 2'000);
+    auto lit = b.lower_bound_left(from);
+    auto mlit = left_view.lower_bound(from);
+    auto rit = b.lower_bound_right(from);
+    auto mrit = right_view.lower_bound(from);
+    for (size_t step = 0; step < 6; step++) {
+      bool forward = e() % 2 == 0;
+      if (forward && mlit != left_view.end()) {
+        ++lit, ++mlit;
+      } else if (!forward && mlit != left_view.begin()) {
+        --lit, --mlit;
+      }
+      if (forward && mrit != right_view.end()) {
+        ++rit, ++mrit;
+      } else if (!forward && mrit != right_view.begin()) {
+        --rit, --mrit;
+      }
+      REQUIRE((lit == b.end_left()) == (mlit == left_view.end()));
+      if (mlit != left_view.end()) {
+        REQUIRE(*lit == mlit->first);
+        REQUIRE(*lit.flip() == mlit->second);
+      }
+      REQUIRE((rit == b.end_right()) == (mrit == right_view.end()));
+      if (mrit != right_view.end()) {
+        REQUIRE(*rit == mrit->first);
+        REQUIRE(*rit.flip() == mrit->second);
+      }
+    }
+  }
+}
+
+TEST_CASE("[Randomized] - Compact pool") {
+  INFO("Seed used for randomized compact pool test is " << seed);
+
+  using compact_bimap = bimap<int, int, std::less<int>, std::less<int>, bimap_policy::compact>;
+  compact_bimap b;
+  std::map<int, int> left_view, right_view;
+
+  // The pool only grows when a pair is actually inserted into a full one, and reuses the slots of erased pairs
+  // before that. Until it grows or is shrunk, an iterator to a pair that stays in the bimap keeps pointing at it.
+  // Growing moves the end too, so results are compared with the end only after the call.
+  std::mt19937 e(seed);
+  int saved_key = 0;
+  compact_bimap::left_iterator saved = b.end_left();
+  auto record = [&](int l, int r) {
+    left_view.insert({l, r});
+    right_view.insert({r, l});
+    if (saved == b.end_left()) {
+      saved_key = l;
+      saved = b.find_left(l);
+    }
+  };
+  for (size_t i = 0; i < 50'000; i++) {
+    std::size_t capacity_before = b.capacity();
+    bool resized = false;
+    int l = e() % 1'000, r = e() % 1'000;
+    switch (e() % 10) {
+    case 0:
+    case 1:
+      if (auto it = b.insert(l, r); it != b.end_left()) {
+        record(l, r);
+      }
+      break;
+    case 2:
+      if (auto it = b.emplace(std::piecewise_construct, std::tuple(l), std::tuple(r)); it != b.end_left()) {
+        record(l, r);
+      }
+      break;
+    case 3:
+      if (auto it = b.try_emplace_left(l, r); it != b.end_left()) {
+        record(l, r);
+      }
+      break;
+    case 4: {
+      std::vector<std::pair<int, int>> batch(e() % 20);
+      for (auto& [bl, br] : batch) {
+        bl = static_cast<int>(e() % 1'000);
+        br = static_cast<int>(e() % 1'000);
+      }
+      b.insert_range(batch.begin(), batch.end());
+      for (auto [bl, br] : batch) {
+        if (auto it = b.find_left(bl); it != b.end_left() && *it.flip() == br && !left_view.contains(bl)) {
+          record(bl, br);
+        }
+      }
+      break;
+    }
+    case 5:
+    case 6:
+      if (auto it = b.lower_bound_left(l); it != b.end_left() && *it != saved_key) {
+        right_view.erase(*it.flip());
+        left_view.erase(*it);
+        b.erase_left(it);
+      }
+      break;
+    case 7:
+      if (auto it = left_view.lower_bound(l); it != left_view.end()) {
+        REQUIRE(b.at_left_or_default(it->first) == it->second);
+      }
+      break;
+    case 8:
+      if (e() % 20 == 0) {
+        b.reserve(e() % 100);
+        resized = true;
+      }
+      break;
+    default:
+      if (e() % 50 == 0) {
+        b.shrink_to_fit();
+        resized = true;
+      } else if (e() % 50 == 0) {
+        b.clear();
+        left_view.clear();
+        right_view.clear();
+        saved = b.end_left();
+      }
+    }
+
+    REQUIRE(b.size() == left_view.size());
+    REQUIRE(b.capacity() >= b.size());
+    if (!resized && b.capacity() != capacity_before) {
+      REQUIRE(b.size() > capacity_before);
+    }
+    if (resized || b.capacity() != capacity_before) {
+      saved = b.find_left(saved_key);
+    }
+    if (saved != b.end_left()) {
+      REQUIRE(*saved == saved_key);
+      REQUIRE(*saved.flip() == left_view.at(saved_key));
+    }
+    if (i % 1'000 == 0) {
+      REQUIRE(std::equal(b.begin_left(), b.end_left(), left_view.begin(), left_view.end(),
+                         [](int key, const auto& p) { return key == p.first; }));
+      REQUIRE(std::equal(b.begin_right(), b.end_right(), right_view.begin(), right_view.end(),
+                         [](int key, const auto& p) { return key == p.first; }));
+    }
+  }
+}
+
+TEST_CASE("[Randomized] - Split halves") {
+  INFO("Seed used for randomized split halves test is " << seed);
+
+  using split_bimap = bimap<std::string, int, std::less<std::string>, std::less<int>, bimap_policy::split>;
+  split_bimap bimaps[2];
+  std::map<std::string, int> left_views[2];
+  std::map<int, std::string> right_views[2];
+
+  // Whichever way a pair got into the bimap, its right half starts a cache line of its own that the left
+  // half does not touch, and each half finds the other one.
+  auto check_halves = [](split_bimap::left_iterator it) {
+    auto left = reinterpret_cast<std::uintptr_t>(&*it);
+    auto right = reinterpret_cast<std::uintptr_t>(&*it.flip());
+    REQUIRE(left / 64 != right / 64);
+    REQUIRE(right % 64 < sizeof(void*) * 3 + sizeof(int));
+    REQUIRE(it.flip().flip() == it);
+  };
+
+  std::mt19937 e(seed);
+  for (size_t i = 0; i < 20'000; i++) {
+    size_t k = e() % 2;
+    split_bimap& b = bimaps[k];
+    std::string l = std::to_string(e() % 1'000);
+    int r = static_cast<int>(e() % 1'000);
+    switch (e() % 8) {
+    case 0:
+    case 1:
+      if (b.insert(l, r) != b.end_left()) {
+        left_views[k].insert({l, r});
+        right_views[k].insert({r, l});
+      }
+      break;
+    case 2:
+      if (b.emplace(std::piecewise_construct, std::forward_as_tuple(l), std::forward_as_tuple(r)) != b.end_left()) {
+        left_views[k].insert({l, r});
+        right_views[k].insert({r, l});
+      }
+      break;
+    case 3:
+      if (auto it = b.lower_bound_right(r); it != b.end_right()) {
+        left_views[k].erase(*it.flip());
+        right_views[k].erase(*it);
+        b.erase_right(it);
+      }
+      break;
+    case 4:
+      if (auto it = b.lower_bound_right(r); it != b.end_right() && !left_views[k].contains(l)) {
+        left_views[k].erase(*it.flip());
+        left_views[k].insert({l, *it});
+        right_views[k][*it] = l;
+        check_halves(b.replace_left(it, l));
+      }
+      break;
+    case 5:
+      if (auto it = b.lower_bound_left(l); it != b.end_left() && !right_views[k].contains(r)) {
+        right_views[k].erase(*it.flip());
+        right_views[k].insert({r, *it});
+        left_views[k][*it] = r;
+        check_halves(b.replace_right(it, r).flip());
+      }
+      break;
+    case 6:
+      if (e() % 50 == 0) {
+        bimaps[1 - k] = b;
+        left_views[1 - k] = left_views[k];
+        right_views[1 - k] = right_views[k];
+      }
+      break;
+    default:
+      if (e() % 50 == 0) {
+        swap(bimaps[0], bimaps[1]);
+        std::swap(left_views[0], left_views[1]);
+        std::swap(right_views[0], right_views[1]);
+      }
+    }
+
+    REQUIRE(b.size() == left_views[k].size());
+    if (auto it = b.lower_bound_left(l); it != b.end_left()) {
+      check_halves(it);
+      REQUIRE(*it.flip() == left_views[k].at(*it));
+    }
+    if (auto it = b.lower_bound_right(r); it != b.end_right()) {
+      check_halves(it.flip());
+      REQUIRE(*it.flip() == right_views[k].at(*it));
+    }
+    if (i % 1'000 == 0) {
+      for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+        check_halves(it);
+      }
+      REQUIRE(std::equal(b.begin_right(), b.end_right(), right_views[k].begin(), right_views[k].end(),
+                         [](int key, const auto& p) { return key == p.first; }));
+    }
+  }
+}
+
+TEST_CASE("[Randomized] - Splay lookups") {
+  INFO("Seed used for randomized splay lookups test is " << seed);
+
+  size_t calls = 0;
+  using splay_bimap = bimap<int, int, three_way_comparator, three_way_comparator, bimap_policy::splay>;
+  splay_bimap b(three_way_comparator{&calls}, three_way_comparator{&calls});
+  const splay_bimap& view = b;
+  // `three_way_comparator` orders keys backwards.
+  std::map<int, int, std::greater<>> left_view, right_view;
+  std::map<int, splay_bimap::left_iterator> held;
+
+  // Most lookups go to a few hot keys. A key that was just found is at the root, so looking it up again
+  // takes a single comparison, while const lookups leave the shape alone. Iterators survive the splaying.
+  std::mt19937 e(seed);
+  for (size_t i = 0; i < 50'000; i++) {
+    int l = static_cast<int>(e() % 8 == 0 ? e() % 1'000 : e() % 16);
+    int r = static_cast<int>(e() % 8 == 0 ? e() % 1'000 : e() % 16);
+    switch (e() % 8) {
+    case 0:
+      if (auto it = b.insert(l, r); it != b.end_left()) {
+        left_view.insert({l, r});
+        right_view.insert({r, l});
+        if (e() % 4 == 0) {
+          held.insert({l, it});
+        }
+      }
+      break;
+    case 1:
+      if (!held.contains(l) && b.erase_left(l)) {
+        right_view.erase(left_view.at(l));
+        left_view.erase(l);
+      }
+      break;
+    case 2:
+    case 3:
+      if (b.find_left(l) != b.end_left()) {
+        calls = 0;
+        REQUIRE(*b.find_left(l).flip() == left_view.at(l));
+        REQUIRE(calls == 1);
+      } else {
+        REQUIRE(!left_view.contains(l));
+      }
+      break;
+    case 4:
+    case 5:
+      if (right_view.contains(r)) {
+        REQUIRE(b.at_right(r) == right_view.at(r));
+        calls = 0;
+        REQUIRE(b.find_right(r) != b.end_right());
+        REQUIRE(calls == 1);
+      } else {
+        REQUIRE_THROWS_AS(b.at_right(r), std::out_of_range);
+      }
+      break;
+    default: {
+      calls = 0;
+      bool found = view.find_left(l) != view.end_left();
+      size_t const_calls = calls;
+      calls = 0;
+      REQUIRE((view.find_left(l) != view.end_left()) == found);
+      REQUIRE(calls == const_calls);
+      REQUIRE(found == left_view.contains(l));
+    }
+    }
+
+    REQUIRE(b.size() == left_view.size());
+    for (auto [left, it] : held) {
+      REQUIRE(*it == left);
+      REQUIRE(*it.flip() == left_view.at(left));
+    }
+    if (i % 1'000 == 0) {
+      REQUIRE(std::equal(b.begin_left(), b.end_left(), left_view.begin(), left_view.end(),
+                         [](int key, const auto& p) { return key == p.first; }));
+      REQUIRE(std::equal(b.begin_right(), b.end_right(), right_view.begin(), right_view.end(),
+                         [](int key, const auto& p) { return key == p.first; }));
+    }
+  }
+}
+
+TEST_CASE("[Randomized] - Small inline slots") {
+  INFO("Seed used for randomized small inline slots test is " << seed);
+
+  using small_bimap = bimap<int, int, std::less<int>, std::less<int>, bimap_policy::small<4>>;
+  small_bimap b;
+  std::map<int, int> left_view, right_view;
+  std::map<int, small_bimap::left_iterator> held;
+
+  // The size wanders back and forth across the inline capacity, so pairs keep moving between linear lookups
+  // in the slots and the trees. Lookups on both sides must agree with the maps, and iterators to every pair
+  // must survive all of it.
+  std::mt19937 e(seed);
+  size_t target = 0;
+  for (size_t i = 0; i < 100'000; i++) {
+    if (i % 16 == 0) {
+      target = e() % 10;
+    }
+    int l = e() % 16, r = e() % 16;
+    if (b.size() < target) {
+      if (auto it = b.insert(l, r); it != b.end_left()) {
+        left_view.insert({l, r});
+        right_view.insert({r, l});
+        held.insert({l, it});
+      }
+    } else if (b.size() > target) {
+      if (auto it = b.lower_bound_right(r); it != b.end_right()) {
+        held.erase(*it.flip());
+        left_view.erase(*it.flip());
+        right_view.erase(*it);
+        b.erase_right(it);
+      }
+    }
+
+    REQUIRE(b.size() == left_view.size());
+    REQUIRE(b.capacity() >= 4);
+    for (auto [left, it] : held) {
+      REQUIRE(*it == left);
+      REQUIRE(*it.flip() == left_view.at(left));
+    }
+    auto lit = b.lower_bound_left(l);
+    auto mlit = left_view.lower_bound(l);
+    REQUIRE((lit == b.end_left()) == (mlit == left_view.end()));
+    if (mlit != left_view.end()) {
+      REQUIRE(*lit == mlit->first);
+    }
+    auto rit = b.upper_bound_right(r);
+    auto mrit = right_view.upper_bound(r);
+    REQUIRE((rit == b.end_right()) == (mrit == right_view.end()));
+    if (mrit != right_view.end()) {
+      REQUIRE(*rit == mrit->first);
+    }
+    REQUIRE((b.find_left(l) == b.end_left()) == !left_view.contains(l));
+    REQUIRE((b.find_right(r) == b.end_right()) == !right_view.contains(r));
+  }
+}
+
+TEST_CASE("[Randomized] - Small bimaps") {
+  INFO("Seed used for randomized small bimaps test is " << seed);
+
+  using small_bimap = bimap<int, int, std::less<int>, std::less<int>, bimap_policy::small<4>>;
+  small_bimap bimaps[2];
+  std::map<int, int> left_views[2], right_views[2];
+
+  std::mt19937 e(seed);
+  for (size_t i = 0; i < 100'000; i++) {
+    size_t k = e() % 2;
+    small_bimap& b = bimaps[k];
+    int l = e() % 8, r = e() % 8;
+    switch (e() % 5) {
+    case 0:
+    case 1:
+      if (auto it = b.insert(l, r); it != b.end_left()) {
+        left_views[k].insert({l, r});
+        right_views[k].insert({r, l});
+      }
+      break;
+    case 2:
+      if (b.erase_right(r)) {
+        left_views[k].erase(right_views[k].at(r));
+        right_views[k].erase(r);
+      }
+      break;
+    case 3:
+      swap(bimaps[0], bimaps[1]);
+      std::swap(left_views[0], left_views[1]);
+      std::swap(right_views[0], right_views[1]);
+      break;
+    default:
+      bimaps[!k] = std::move(b);
+      left_views[!k] = std::move(left_views[k]);
+      right_views[!k] = std::move(right_views[k]);
+      left_views[k].clear();
+      right_views[k].clear();
+      break;
+    }
+
+    for (size_t j = 0; j < 2; j++) {
+      REQUIRE(bimaps[j].size() == left_views[j].size());
+      auto lit = bimaps[j].begin_left();
+      for (auto [left, right] : left_views[j]) {
+        REQUIRE(*lit == left);
+        REQUIRE(*lit.flip() == right);
+        REQUIRE(bimaps[j].at_right(right) == left);
+        ++lit;
+      }
+      REQUIRE(lit == bimaps[j].end_left());
+    }
+  }
+}
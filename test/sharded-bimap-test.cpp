@@ -0,0 +1,192 @@
+#include "sharded-bimap.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Both sides hold the same pairs, and the count matches them.
+template <typename Sharded>
+void check_consistency(const Sharded& b) {
+  std::size_t pairs = 0;
+  b.for_each([&](const auto& left, const auto& right) {
+    ++pairs;
+    auto found = b.find_right(right);
+    REQUIRE(found.has_value());
+    REQUIRE(*found == left);
+  });
+  REQUIRE(pairs == b.size());
+}
+
+template <typename F>
+void run_threads(std::size_t count, F f) {
+  std::vector<std::thread> threads;
+  threads.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    threads.emplace_back(f, i);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Orders keys by their remainder, so keys with the same one are equivalent. Has no default constructor.
+class remainder_comparator {
+public:
+  explicit remainder_comparator(int divisor)
+      : divisor(divisor) {}
+
+  bool operator()(int lhs, int rhs) const {
+    return lhs % divisor < rhs % divisor;
+  }
+
+private:
+  int divisor;
+};
+
+} // namespace
+
+TEST_CASE("Sharded bimap") {
+  sharded_bimap<int, std::string> b(4);
+  CHECK(b.empty());
+  CHECK(b.insert(1, "a"));
+  CHECK(b.insert(2, "b"));
+  CHECK_FALSE(b.insert(1, "c"));
+  CHECK_FALSE(b.insert(3, "b"));
+  CHECK(b.size() == 2);
+  CHECK(b.find_left(1) == "a");
+  CHECK(b.find_right("b") == 2);
+  CHECK_FALSE(b.find_left(3).has_value());
+  CHECK_FALSE(b.find_right("c").has_value());
+
+  CHECK(b.erase_right("a"));
+  CHECK_FALSE(b.erase_right("a"));
+  CHECK(b.insert(1, "c"));
+  CHECK(b.erase_left(2));
+  CHECK_FALSE(b.erase_left(2));
+  CHECK(b.size() == 1);
+  CHECK(b.find_right("c") == 1);
+  check_consistency(b);
+}
+
+TEST_CASE("Sharded bimap passes comparators to every shard") {
+  using remainder_bimap =
+      sharded_bimap<int, int, std::hash<int>, std::hash<int>, remainder_comparator, remainder_comparator>;
+  remainder_bimap b(1, {}, {}, remainder_comparator(10), remainder_comparator(100));
+  CHECK(b.insert(1, 2));
+  CHECK_FALSE(b.insert(11, 3));
+  CHECK_FALSE(b.insert(4, 102));
+  CHECK(b.insert(4, 12));
+  CHECK(b.find_left(21) == 2);
+  CHECK(b.find_right(202) == 1);
+  CHECK(b.erase_right(112));
+  CHECK(b.erase_left(31));
+  CHECK(b.empty());
+
+  remainder_bimap sharded(8, {}, {}, remainder_comparator(10), remainder_comparator(10));
+  for (int i = 0; i < 100; i++) {
+    sharded.insert(i, i);
+  }
+  CHECK(sharded.size() > 10);
+  sharded.for_each([&](int left, int right) {
+    CHECK(sharded.find_left(left) == right);
+    CHECK(sharded.find_right(right) == left);
+  });
+}
+
+TEST_CASE("Sharded bimap agrees with bimap") {
+  sharded_bimap<int, int> sharded(8);
+  bimap<int, int> reference;
+  std::mt19937 e(std::mt19937::default_seed);
+  for (int i = 0; i < 20'000; i++) {
+    int left = static_cast<int>(e() % 500);
+    int right = static_cast<int>(e() % 500);
+    switch (e() % 4) {
+    case 0:
+      REQUIRE(sharded.erase_left(left) == reference.erase_left(left));
+      break;
+    case 1:
+      REQUIRE(sharded.erase_right(right) == reference.erase_right(right));
+      break;
+    default: {
+      bool inserted = reference.insert(left, right) != reference.end_left();
+      REQUIRE(sharded.insert(left, right) == inserted);
+    }
+    }
+  }
+  REQUIRE(sharded.size() == reference.size());
+  for (auto it = reference.begin_left(); it != reference.end_left(); ++it) {
+    REQUIRE(sharded.find_left(*it) == *it.flip());
+  }
+  check_consistency(sharded);
+}
+
+TEST_CASE("Sharded bimap keeps keys unique across threads") {
+  constexpr int keys = 2'000;
+  sharded_bimap<int, int> b(16);
+  std::atomic<int> inserted = 0;
+  // Every thread tries every left key, and right keys overlap between threads, so the threads race
+  // for keys on both sides.
+  run_threads(4, [&](std::size_t thread) {
+    for (int i = 0; i < keys; i++) {
+      if (b.insert(i, (i * 7 + static_cast<int>(thread)) % keys)) {
+        inserted.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  });
+  CHECK(b.size() == static_cast<std::size_t>(inserted.load()));
+  check_consistency(b);
+}
+
+TEST_CASE("Sharded bimap stays consistent under concurrent changes") {
+  sharded_bimap<int, int> b(8);
+  run_threads(4, [&](std::size_t thread) {
+    std::mt19937 e(static_cast<std::mt19937::result_type>(thread));
+    for (int i = 0; i < 20'000; i++) {
+      int left = static_cast<int>(e() % 200);
+      int right = static_cast<int>(e() % 200);
+      switch (e() % 3) {
+      case 0:
+        b.erase_left(left);
+        break;
+      case 1:
+        b.erase_right(right);
+        break;
+      default:
+        b.insert(left, right);
+      }
+    }
+  });
+  check_consistency(b);
+}
+
+TEST_CASE("Sharded bimap inserts both sides at once") {
+  constexpr int keys = 20'000;
+  sharded_bimap<int, int> b(16);
+  std::atomic<bool> done = false;
+  std::atomic<int> mismatches = 0;
+  run_threads(3, [&](std::size_t thread) {
+    if (thread == 0) {
+      for (int i = 0; i < keys; i++) {
+        b.insert(i, -i);
+      }
+      done = true;
+      return;
+    }
+    std::mt19937 e(static_cast<std::mt19937::result_type>(thread));
+    while (!done) {
+      int i = static_cast<int>(e() % keys);
+      // Once the right side has the pair, the left side must have it too.
+      if (b.find_right(-i).has_value() && b.find_left(i) != -i) {
+        mismatches.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  });
+  CHECK(mismatches == 0);
+  CHECK(b.size() == keys);
+}
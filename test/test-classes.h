@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cmath>
+#include <compare>
+#include <cstddef>
 #include <functional>
 #include <stdexcept>
 #include <unordered_set>
@@ -50,11 +52,11 @@ public:
       : type(p) {}
 
   bool operator()(vec lhs, vec rhs) const {
-    if (type == euclidean) {
-      return euc(lhs) < euc(rhs);
-    } else {
-      return man(lhs) < man(rhs);
-    }
+    return project(lhs) < project(rhs);
+  }
+
+  double project(vec x) const {
+    return type == euclidean ? euc(x) : man(x);
   }
 
 private:
@@ -216,6 +218,9 @@ class expiring_comparator {
 public:
   expiring_comparator() = default;
 
+  explicit expiring_comparator(bool expired) noexcept
+      : has_expired(expired) {}
+
   expiring_comparator(const expiring_comparator&) = default;
 
   expiring_comparator(expiring_comparator&& other) noexcept
@@ -259,6 +264,22 @@ private:
   bool* called;
 };
 
+class three_way_comparator {
+public:
+  explicit three_way_comparator(size_t* calls = nullptr)
+      : calls(calls) {}
+
+  std::strong_ordering operator()(int lhs, int rhs) const {
+    if (calls) {
+      ++*calls;
+    }
+    return rhs <=> lhs;
+  }
+
+private:
+  size_t* calls;
+};
+
 class counter_moved {
 public:
   static constexpr int MOVED_DATA = -1;